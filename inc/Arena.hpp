@@ -0,0 +1,89 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Frame-lifetime memory arena.
+
+ The scratch buffers of the metrics are carved out of a single block by
+ bumping an offset, each one aligned on a cache line, and are all released
+ at once by reset() before the next frame. When a frame needs more memory
+ than the block holds, further blocks are allocated, and replaced by a
+ single block of the total size at the next reset(), so that once the
+ arena has seen a frame of each kind no memory is allocated anymore.
+
+**************************************************************************/
+
+#ifndef Arena_hpp
+#define Arena_hpp
+
+#include <cstddef>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+class Arena {
+public:
+	// Alignment of every allocation, the size of a cache line
+	static const size_t ALIGNMENT = 64;
+
+	Arena();
+	~Arena();
+	// Back the blocks allocated from now on with transparent huge pages,
+	// where supported (default: false)
+	void setHugePages(bool enable);
+	// Return size bytes aligned on ALIGNMENT, valid until the next reset()
+	void *allocate(size_t size);
+	template <class T> T *allocate(size_t n)
+	{
+		return static_cast<T*>(allocate(n * sizeof(T)));
+	}
+	// Return a continuous matrix of the arena, valid until the next reset()
+	// Its content is undefined.
+	cv::Mat mat(int rows, int cols, int type);
+	// Release all the allocations at once
+	void reset();
+	// Number of blocks allocated from the system since the construction,
+	// which stays constant in steady state
+	size_t blockCount() const;
+private:
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	struct Block {
+		char *data;
+		size_t size;
+	};
+	// Allocate a block of at least size bytes and make it current
+	void grow(size_t size);
+	Block allocateBlock(size_t size) const;
+	static void freeBlock(const Block& block);
+
+	std::vector<Block> blocks;
+	size_t current;		// block allocations are taken from
+	size_t offset;		// first free byte of the current block
+	size_t nballocated;
+	bool huge_pages;
+};
+
+#endif
@@ -37,28 +37,34 @@
 #include <vector>
 
 
-class EWPSNR : protected Metric {
+class EWPSNR : public Metric {
 public:
 
-	EWPSNR(int height, int width);
+	EWPSNR(int height, int width, int bitdepth = 8);
 	// Compute the PSNR index of the processed image
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	// set_frame_no() needs to be called with the same workspace before
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
 
 	bool match_eye_track_data(std::string filename);
+	// Load the gazes of each frame from an eye-tracking file of the SFU
+	// database, instead of the one matching the name of the original video
+	bool load_eye_track_data(const std::string& path);
 
-    void set_frame_no(unsigned int no) { m_frame_no = no; };
+	// Select the gazes of the given frame for the next calls to compute()
+	// with the workspace
+    void set_frame_no(Workspace& ws, unsigned int no) const;
 
 private:
-	float WPSNR(const cv::Mat& original, const cv::Mat& processed, const cv::Mat& w);
-    void compute_eye_weight(cv::Mat& w);
-	bool load_eye_track_data();
-    double retina_gaussian (int x,int y, float x_e, float y_e, int sigma_x, int sigma_y);
+	struct State;
+
+	float WPSNR(const cv::Mat& original, const cv::Mat& processed, const cv::Mat& w, Workspace& ws) const;
+    void compute_eye_weight(cv::Mat& w, unsigned int frame_no) const;
+    static double retina_gaussian (int x,int y, float x_e, float y_e, int sigma_x, int sigma_y);
 
 
 
 	std::string m_id;
 	std::string m_path;
-    unsigned int m_frame_no;
 
     std::vector<std::vector<std::pair<float, float>>> m_gazes;
 
@@ -0,0 +1,79 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Features of the frames being measured which several metrics need:
+ element-wise products, squared errors and window moments.
+
+ Entries are keyed by the data pointer and geometry of their input images,
+ so the inputs have to be frame buffers (or entries of the cache) which
+ stay unchanged until clear() is called for the next frame.
+
+**************************************************************************/
+
+#ifndef FeatureCache_hpp
+#define FeatureCache_hpp
+
+#include <deque>
+#include <opencv2/core/core.hpp>
+
+class FeatureCache {
+public:
+	FeatureCache();
+	// Forget the features of the previous frame, their buffers are kept
+	// for the next one
+	void clear();
+	// Return a.*b (a.^2 when b is a)
+	const cv::Mat& product(const cv::Mat& a, const cv::Mat& b);
+	// Return (a-b).^2
+	const cv::Mat& squaredError(const cv::Mat& a, const cv::Mat& b);
+	// Set mu and sq to the entries holding the filtered img and img.^2
+	// for a Gaussian window of size ksize and standard deviation sigma
+	// Return false when they are new, then the caller has to compute them
+	bool moments(const cv::Mat& img, int ksize, double sigma, cv::Mat*& mu, cv::Mat*& sq);
+private:
+	enum Feature {
+		FEATURE_PRODUCT = 0,
+		FEATURE_SQUARED_ERROR,
+		FEATURE_MOMENTS
+	};
+	struct Entry {
+		int feature;
+		const unsigned char *a, *b;
+		int rows, cols, type;
+		int ksize;
+		double sigma;
+		cv::Mat mat[2];
+	};
+	// Return the entry of the key, adding it if needed
+	Entry& lookup(int feature, const cv::Mat& a, const cv::Mat& b, int ksize, double sigma, bool& found);
+
+	// Entries of the current frame come first, a deque keeps the addresses
+	// of the matrices returned to the metrics stable
+	std::deque<Entry> entries;
+	size_t used;
+};
+
+#endif
@@ -0,0 +1,76 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Bounded ring of reusable frame buffers shared by one producer (the
+ thread reading the input file) and one consumer (the metric stage).
+
+ Slots are handed over through two monotonic counters, so neither side
+ ever takes a lock: the producer only writes 'tail' and the consumer only
+ writes 'head'.
+
+**************************************************************************/
+
+#ifndef FrameRing_hpp
+#define FrameRing_hpp
+
+#include <stddef.h>
+#include <atomic>
+
+class FrameRing {
+public:
+	FrameRing(size_t frame_size, int nbslots);
+	~FrameRing();
+
+	// Producer side
+	// Return a free slot to fill, or nullptr once the consumer has closed
+	// the ring
+	unsigned char *acquireFree();
+	// Hand the slot returned by acquireFree() to the consumer
+	void publish();
+	// Signal that no more frames will be published
+	void finish();
+
+	// Consumer side
+	// Return the oldest published frame, or nullptr when the producer has
+	// finished and all frames have been consumed
+	const unsigned char *acquireReady();
+	// Give the slot returned by acquireReady() back to the producer
+	void release();
+	// Stop the producer: acquireFree() returns nullptr from now on
+	void close();
+private:
+	// Wait a bit longer after each unsuccessful attempt
+	static void backoff(int& spins);
+
+	unsigned char **slots;
+	unsigned nbslots;
+	std::atomic<unsigned> head;	// number of frames released by the consumer
+	std::atomic<unsigned> tail;	// number of frames published by the producer
+	std::atomic<bool> finished;
+	std::atomic<bool> closed;
+};
+
+#endif
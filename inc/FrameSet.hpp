@@ -0,0 +1,60 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Frames of one instant of the original video and of each processed video,
+ in the representations needed by the selected metrics.
+
+**************************************************************************/
+
+#ifndef FrameSet_hpp
+#define FrameSet_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+struct FrameSet {
+	// Luma, CV_32F
+	cv::Mat original;
+	std::vector<cv::Mat> processed;
+	// U and V planes at their own size, CV_32F, 2 per processed video
+	cv::Mat original_chroma[2];
+	std::vector<cv::Mat> processed_chroma;
+	// Y, U and V planes with the type of the samples (CV_8UC1, or CV_16UC1
+	// above 8 bits per sample), 3 per processed video
+	// They are either headers on the frame data of the input videos or
+	// copies of it, see VideoYUV::getPlane().
+	cv::Mat original_planes[3];
+	std::vector<cv::Mat> processed_planes;
+
+	// Allocate the converted frames which are needed, the planes are
+	// allocated when they are first copied
+	void allocate(int height, int width, int chroma_height, int chroma_width, bool luma, bool chroma,
+		size_t nbprocessed);
+	// Planes of the i-th processed video
+	const cv::Mat *planes(size_t i) const { return &processed_planes[3 * i]; }
+};
+
+#endif
@@ -0,0 +1,95 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Hand-vectorized kernels of the metrics' inner loops.
+
+ Each kernel is compiled for several instruction sets (generic C++,
+ SSE4.2, AVX2 and AVX-512) and the variant used is selected at runtime,
+ so one binary runs on any x86 CPU while using its widest vectors.
+
+**************************************************************************/
+
+#ifndef Kernels_hpp
+#define Kernels_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Attributes.hpp"
+
+class Kernels {
+public:
+	// Instruction sets, ordered from the least to the most capable
+	enum Level {
+		LEVEL_GENERIC = 0,
+		LEVEL_SSE42,
+		LEVEL_AVX2,
+		LEVEL_AVX512,
+		LEVEL_SIZE
+	};
+
+	// Return the most capable instruction set supported by the CPU
+	static Level detect();
+	// Use the kernels of the given instruction set
+	// Return false if it is not supported by the CPU
+	static bool select(Level level);
+	// Return the instruction set currently used
+	static Level selected();
+	// Name of an instruction set, as accepted by parse()
+	static const char *name(Level level) ATTRIBUTE_CONST;
+	// Parse the name of an instruction set
+	static bool parse(const char *str, Level& level);
+
+	// Sum of (a[i]-b[i])^2 for i in [0, n)
+	static double sumSquaredDiff(const float *a, const float *b, int n);
+	// Same on integer samples, exact whatever the order of the additions
+	static uint64_t sumSquaredDiff(const unsigned char *a, const unsigned char *b, int n);
+	static uint64_t sumSquaredDiff(const unsigned short *a, const unsigned short *b, int n);
+
+	// DCT coefficients and masking of n consecutive 8x8 blocks for PSNR-HVS
+	// src is the top-left sample of the first block and stride the distance
+	// between its rows, in samples. The 64 coefficients of block j (the
+	// orthonormal 2D DCT-II, as cv::dct) are stored row by row from
+	// dct+64*j, and its masking (maskeff() of the reference code) in
+	// mask[j], mask_table being MASK(k,l) stored row by row.
+	static void hvsTransform(const float *src, size_t stride, int n, const float *mask_table,
+		float *dct, float *mask);
+	// CSF-weighted squared DCT errors of one 8x8 block for PSNR-HVS (s2)
+	// and PSNR-HVS-M (s1), where the errors are first reduced by the
+	// masking threshold mask/MASK(k,l) except for the DC coefficient
+	// The 64 coefficients of each table are stored row by row.
+	static void hvsBlock(const float *a_dct, const float *b_dct, const float *csf, const float *mask_table,
+		float mask, double& s1, double& s2);
+
+	// Per-pixel VIFp statistics of n pixels from the local means mu1, mu2
+	// and the local second moments e11, e22, e12 (filtered x^2, y^2, xy)
+	// Adds the sums of ln(1+g^2*sigma1_sq/(sv_sq+sigma_nsq)) to num and of
+	// ln(1+sigma1_sq/sigma_nsq) to den, the vectorized variants with a
+	// polynomial logarithm.
+	static void vifLogSums(const float *mu1, const float *mu2, const float *e11, const float *e22,
+		const float *e12, float sigma_nsq, int n, double& num, double& den);
+};
+
+#endif
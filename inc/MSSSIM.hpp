@@ -48,25 +48,32 @@
 
 #include "SSIM.hpp"
 
-class MSSSIM : protected SSIM {
+class MSSSIM : public SSIM {
 public:
-	MSSSIM(int height, int width);
+	MSSSIM(int height, int width, int bitdepth = 8);
 	// Compute the SSIM and MS-SSIM indexes of the processed image
 	// Return the MS-SSIM index
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
+	// Compute the pyramid of the original image and the terms of each level
+	// which only depend on it, shared by the next calls to compute() with
+	// the same workspace
+	// The original image has to stay valid until then.
+	void setReference(const cv::Mat& original, Workspace& ws) const;
+	// Compute the SSIM and MS-SSIM indexes of the processed image against
+	// the reference
+	// Return the MS-SSIM index
+	float compute(const cv::Mat& processed, Workspace& ws) const;
 	// Return the SSIM index only
-	// compute() needs to be called before getSSIM()
-	float getSSIM();
+	// compute() needs to be called with the workspace before getSSIM()
+	float getSSIM(Workspace& ws) const;
 	// Return the MS-SSIM index only
-	// compute() needs to be called before getMSSSIM()
-	float getMSSSIM();
+	// compute() needs to be called with the workspace before getMSSSIM()
+	float getMSSSIM(Workspace& ws) const;
 private:
-	double ssim;
-	double msssim;
+	struct State;
+
 	static const int NLEVS = 5;
 	static const double WEIGHT[];
-	cv::Mat im1[NLEVS];
-	cv::Mat im2[NLEVS];
 };
 
 #endif
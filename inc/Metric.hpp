@@ -26,24 +26,102 @@
 #define Metric_hpp
 
 #include <cmath>
+#include <functional>
+#include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include "FeatureCache.hpp"
+#include "ThreadPool.hpp"
+#include "Workspace.hpp"
 
 class Metric {
 public:
-	Metric(int height, int width, int i = CV_32F);
+	Metric(int height, int width, int i = CV_32F, int bitdepth = 8);
 	virtual ~Metric();
-	virtual float compute(const cv::Mat& original, const cv::Mat& processed) = 0;
+	// Compute the index of the processed image
+	// The metric itself is not modified: it can be called by several
+	// threads at once, provided that each of them uses its own workspace.
+	// The features are shared with the other metrics through the cache of
+	// the workspace, and the frames are split in bands of rows computed in
+	// parallel by its thread pool, if any. The bands do not depend on the
+	// number of threads, neither do the results.
+	virtual float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const = 0;
 protected:
+	// Number of output rows of a band, a multiple of 8 so that the bands
+	// of the block-based metrics are aligned on blocks
+	static const int BAND_ROWS = 64;
 	int height;
 	int width;
-	// Smoothing using a Gaussian kernel of size ksize with standard deviation sigma
+	// Peak sample value, (1 << bitdepth) - 1
+	float peak;
+	// (peak/255)^2, which scales the constants defined for 8-bit samples
+	float range_sq;
+	// Number of bands of BAND_ROWS rows covering the given number of rows
+	static constexpr int bandCount(int rows)
+	{
+		return (rows + BAND_ROWS - 1) / BAND_ROWS;
+	}
+	// Call task(worker, band) for every band in [0, nbands), worker being
+	// in [0, workerCount(ws)), with the thread pool of the workspace
+	// The task is passed by reference, so that no std::function holding a
+	// copy of it is allocated per call.
+	template <class Task> static void forEachBand(const Workspace& ws, int nbands, const Task& task)
+	{
+		runBands(ws, nbands, std::cref(task));
+	}
+	// Number of workers which may compute bands at the same time, i.e. the
+	// number of per-worker buffers needed
+	static int workerCount(const Workspace& ws);
+
+	// Line buffers of filterRows()
+	struct LineBuffers {
+		std::vector<float> ring;	// last ksize horizontally filtered rows of each image
+		std::vector<float> out;		// current output row of each image
+		std::vector<const float*> rows;
+		std::vector<float> box;		// kernel of applyBlur()
+	};
+	// Receives the columns [x0, x0+n) of the output row y of each image
+	typedef std::function<void(int y, int x0, int n, const float* const* rows)> RowConsumer;
+	// Number of output columns filtered at once by filterRows(), such that
+	// the line buffers stay in the L1/L2 caches
+	static const int FILTER_TILE = 512;
+	// Streaming separable filtering of the nsrc images src[] (same size,
+	// CV_32F with any number of channels) with the ksize taps kernel k in
+	// both directions
+	// Only the 'valid' part is computed (no padded borders): output row y
+	// is the filtered input rows [y, y+ksize). The output rows [y0, y1) are
+	// passed to emit() as soon as they are computed, tile by tile, and only
+	// ksize horizontally filtered rows of each image are kept meanwhile.
+	template <class Consumer> static void filterRows(const cv::Mat *src, int nsrc, const float *k, int ksize,
+		int y0, int y1, LineBuffers& buf, const Consumer& emit)
+	{
+		runFilter(src, nsrc, k, ksize, y0, y1, buf, std::cref(emit));
+	}
+	// Reserve the line buffers of filterRows() for nsrc images of the given
+	// width and channels, so that the buffers of a worker which is given
+	// bands of different scales do not grow from frame to frame
+	static void reserveLines(LineBuffers& buf, int nsrc, int cols, int cn, int ksize);
+	// Smoothing using the CV_32F Gaussian kernel returned by
+	// cv::getGaussianKernel(), computed once by the caller
 	// Returns only those parts of the correlation that are computed without zero-padded edges
 	// (similarly to 'filter2' in Matlab with option 'valid')
-	void applyGaussianBlur(const cv::Mat& src, cv::Mat& dst, int ksize, double sigma);
-	void applyBlur(const cv::Mat& src, cv::Mat& dst, int ksize);
+	static void applyGaussianBlur(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kernel, LineBuffers& buf);
+	// Same with the mean over a ksize x ksize window
+	static void applyBlur(const cv::Mat& src, cv::Mat& dst, int ksize, LineBuffers& buf);
+	// Next level of the pyramid of a CV_32FC1 image: the 'valid' Gaussian
+	// smoothing of src with the CV_32F kernel, of which only the even rows
+	// and columns are computed (filtered(1:2:end,1:2:end) in Matlab)
+	static void applyGaussianDecimate(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kernel, LineBuffers& buf);
+	// Same with the mean of each 2x2 block, i.e. half the size of src
+	static void applyAverageDecimate(const cv::Mat& src, cv::Mat& dst, LineBuffers& buf);
 private:
-	cv::Mat gb_tmp;
+	static void runBands(const Workspace& ws, int nbands, const std::function<void(int, int)>& task);
+	static void runFilter(const cv::Mat *src, int nsrc, const float *k, int ksize, int y0, int y1,
+		LineBuffers& buf, const RowConsumer& emit);
+	// Write the filtered image to dst
+	static void filterImage(const cv::Mat& src, cv::Mat& dst, const float *k, int ksize, LineBuffers& buf);
+	// Write the even rows and columns of the filtered image to dst
+	static void decimateImage(const cv::Mat& src, cv::Mat& dst, const float *k, int ksize, LineBuffers& buf);
 };
 
 #endif
@@ -0,0 +1,169 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Registry of the metrics which can be requested on the command line.
+
+ Each metric object is wrapped in a provider, declared with the metrics it
+ computes, the frames it needs and the constraints on their size. Only the
+ providers of the requested metrics are constructed. A metric which comes
+ for free with another one (SSIM with MS-SSIM, PSNR-HVS with PSNR-HVS-M)
+ is declared as such, and taken from the provider which is needed anyway.
+
+**************************************************************************/
+
+#ifndef MetricRegistry_hpp
+#define MetricRegistry_hpp
+
+#include <cstdio>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "Attributes.hpp"
+#include "FrameSet.hpp"
+#include "Workspace.hpp"
+
+// Metrics which can be requested, each one written to its own output file
+enum Metrics {
+	METRIC_PSNR = 0,
+	METRIC_YUVPSNR,
+	METRIC_SSIM,
+	METRIC_YUVSSIM,
+	METRIC_MSSSIM,
+	METRIC_VIFP,
+	METRIC_PSNRHVS,
+	METRIC_PSNRHVSM,
+	METRIC_EWPSNR,
+	METRIC_WSPSNR,
+	METRIC_YUVWSPSNR,
+	METRIC_SIZE
+};
+
+class MetricRegistry {
+public:
+	// Frames given to a provider
+	enum Input {
+		INPUT_LUMA,	// luma plane, CV_32F
+		INPUT_YUV,	// Y, U and V planes at their own size, CV_32F
+		INPUT_PLANES	// Y, U and V planes with the type of the samples
+	};
+
+	// Maximum number of metrics of a provider
+	static const int MAX_METRICS = 2;
+	// Maximum number of values of a metric per frame, see columns()
+	static const int MAX_COLUMNS = 4;
+
+	// Metric object computing one or more metrics
+	class Provider {
+	public:
+		virtual ~Provider();
+		// Compute the metrics of the frame for each processed image from
+		// the frames of the declared input, the values of the k-th
+		// declared metric of the i-th image going to
+		// values[(i*nbmetrics+k)*MAX_COLUMNS+c] for each column c
+		virtual void compute(const FrameSet& set, int frame, Workspace& ws, float *values) const = 0;
+		// Print the sequence-level rows of the summary of the k-th declared
+		// metric of the i-th image, computed from what compute() kept in
+		// the workspaces (default: none)
+		virtual void summary(const std::vector<Workspace>& workspaces, size_t i, int k, FILE *file) const;
+	protected:
+		// Columns of the k-th metric of the i-th image in values
+		static float *columns(float *values, int nbmetrics, size_t i, int k)
+		{
+			return values + (i * static_cast<size_t>(nbmetrics) + static_cast<size_t>(k)) * MAX_COLUMNS;
+		}
+	};
+
+	// Parameters of the construction of the providers
+	struct Parameters {
+		int height;
+		int width;
+		// Height of the chroma planes, 0 for YUV400
+		int chroma_height;
+		int bitdepth;
+		// Name of the original video, which selects the eye-tracking data
+		const char *original_file;
+		// Weights of the Y, U and V planes in the YUV metrics
+		double yuv_weights[3];
+	};
+
+	// Declaration of a provider
+	struct Declaration {
+		// Name used in the error messages
+		const char *name;
+		// Metrics computed, in the order of the values of compute()
+		int metrics[MAX_METRICS];
+		int nbmetrics;
+		// The first nbprimary metrics select the provider when requested,
+		// the others are only taken from it when it is selected anyway
+		int nbprimary;
+		Input input;
+		// The height and width of the video have to be multiples of it
+		int multiple;
+		Provider *(*create)(const Parameters& params);
+	};
+
+	// Return the metric of the given command line name, -1 if none
+	static int find(const char *name);
+	// Suffix of the output file of a metric
+	static const char *suffix(int metric) ATTRIBUTE_CONST;
+	// Number of values of a metric per frame, written as columns of its
+	// output file: the metric itself, then its value on each of the Y, U
+	// and V planes for the YUV metrics
+	static int columns(int metric) ATTRIBUTE_CONST;
+	// Names of the columns of a metric in its output file
+	static const char *header(int metric) ATTRIBUTE_CONST;
+
+	// Select the providers of the requested metrics, which are constructed
+	// by create()
+	explicit MetricRegistry(const bool *requested);
+	~MetricRegistry();
+	// Check the size of the video against the selected providers
+	// Prints an error and returns false if it does not fit one of them.
+	bool checkSize(int height, int width) const;
+	// Whether a selected provider needs the given frames
+	bool needs(Input input) const;
+	// Construct the selected providers
+	void create(const Parameters& params);
+
+	// Number of selected providers
+	size_t size() const;
+	const Declaration& declaration(size_t p) const;
+	const Provider& provider(size_t p) const;
+	// Index of the selected provider a requested metric is taken from, -1
+	// if the metric is not requested
+	int source(int metric) const;
+	// Print the sequence-level rows of the summary of a requested metric
+	// for the i-th processed video, see Provider::summary()
+	void summary(int metric, size_t i, const std::vector<Workspace>& workspaces, FILE *file) const;
+private:
+	MetricRegistry(const MetricRegistry&) = delete;
+	MetricRegistry& operator=(const MetricRegistry&) = delete;
+
+	std::vector<const Declaration*> selected;
+	std::vector<Provider*> providers;
+	int sources[METRIC_SIZE];
+};
+
+#endif
@@ -31,15 +31,41 @@
 #ifndef PSNR_hpp
 #define PSNR_hpp
 
+#include <stdint.h>
 #include "Metric.hpp"
 
-class PSNR : protected Metric {
+class PSNR : public Metric {
 public:
-	PSNR(int height, int width, int t);
+	// Exact sums of the squared errors of the Y, U and V planes and their
+	// numbers of samples, over one frame or more
+	// The sums of different threads, or of different runs over parts of a
+	// sequence, are merged by adding them.
+	struct SquaredErrors {
+		uint64_t sse[3];
+		uint64_t samples[3];
+		SquaredErrors();
+		SquaredErrors& operator+=(const SquaredErrors& other);
+	};
+
+	PSNR(int height, int width, int t, int bitdepth = 8);
 	// Compute the PSNR index of the processed image
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
+	// Sums of the squared errors of the first nbplanes planes of the
+	// samples (CV_8UC1 or CV_16UC1), the others being left to 0
+	static SquaredErrors squaredErrors(const cv::Mat *original, const cv::Mat *processed, int nbplanes);
+	// Compute the PSNR index of the luma plane from its squared errors
+	float compute(const SquaredErrors& errors) const;
+	// Compute the PSNR index of each of the Y, U and V planes from their
+	// squared errors, stored in planes, and return the PSNR of their mean
+	// squared errors weighted by weights
+	// Empty planes (4:0:0) are left out, their PSNR is 0. Equal weights
+	// give the PSNR of the frame with the chroma upsampled to the luma size.
+	float compute(const SquaredErrors& errors, const double *weights, float *planes) const;
 private:
-	cv::Mat tmp;
+	// PSNR index of a mean squared error
+	float fromMSE(double mse) const;
+	// Sum of the squared differences of two planes
+	static uint64_t sumSquaredDiff(const cv::Mat& a, const cv::Mat& b);
 };
 
 #endif
@@ -53,28 +53,41 @@
 #ifndef PSNRHVS_hpp
 #define PSNRHVS_hpp
 
+#include <vector>
 #include "Metric.hpp"
 
-class PSNRHVS : protected Metric {
+class PSNRHVS : public Metric {
 public:
-	PSNRHVS(int height, int width);
+	PSNRHVS(int height, int width, int bitdepth = 8);
 	// Compute the PSNR-HVS-M and PSNR-HVS indexes of the processed image
 	// Return the PSNR-HVS-M index
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
+	// Compute the DCT coefficients and the masking of each block of the
+	// original image, shared by the next calls to compute() with the same
+	// workspace
+	void setReference(const cv::Mat& original, Workspace& ws) const;
+	// Compute the PSNR-HVS-M and PSNR-HVS indexes of the processed image
+	// against the reference
+	// Return the PSNR-HVS-M index
+	float compute(const cv::Mat& processed, Workspace& ws) const;
 	// Return the PSNR-HVS index only
-	// compute() needs to be called before getPSNRHVS()
-	float getPSNRHVS();
+	// compute() needs to be called with the workspace before getPSNRHVS()
+	float getPSNRHVS(Workspace& ws) const;
 	// Return the PSNR-HVS-M index only
-	// compute() needs to be called before getPSNRHVSM()
-	float getPSNRHVSM();
+	// compute() needs to be called with the workspace before getPSNRHVSM()
+	float getPSNRHVSM(Workspace& ws) const;
 private:
-	float psnrhvs;
-	float psnrhvsm;
+	struct State;
+
 	static const float CSF[8][8];
 	static const float MASK[8][8];
-	float maskeff(const cv::Mat &z, const cv::Mat &zdct);
-	float vari(const cv::Mat &z);
-	cv::Mat mean_mat, stddev_mat, a, b, a_dct, b_dct;
+	// DCT coefficients and masking of one row of blocks of the processed
+	// image, computed by one worker
+	struct BlockBuffers {
+		std::vector<float> dct, mask;
+	};
+	// Allocate the buffers of each worker of the workspace
+	State& prepareBuffers(Workspace& ws) const;
 };
 
 #endif
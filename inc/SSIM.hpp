@@ -42,30 +42,67 @@
 #ifndef SSIM_hpp
 #define SSIM_hpp
 
+#include <vector>
 #include "Metric.hpp"
 
-class SSIM : protected Metric {
+class SSIM : public Metric {
 public:
-	SSIM(int height, int width, int t);
+	SSIM(int height, int width, int t, int bitdepth = 8);
 	// Compute the SSIM index of the processed image
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
+	// Compute the terms which only depend on the original image (its local
+	// means and second moments), shared by the next calls to compute() with
+	// the same workspace
+	// The original image has to stay valid until then.
+	void setReference(const cv::Mat& original, Workspace& ws) const;
+	// Compute the SSIM index of the processed image against the reference
+	float compute(const cv::Mat& processed, Workspace& ws) const;
 #if defined(HAVE_SSIM_BLUR_8)
-	cv::Scalar compute_x8(const cv::Mat& original, const cv::Mat& processed);
+	cv::Scalar compute_x8(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
 #endif
 protected:
+	// Means computed by computeMeans(), to be combined
+	enum {
+		SSIM_MEAN = 1,	// mean of the SSIM map
+		CS_MEAN = 2		// mean of the contrast comparison function
+	};
+
 	// Compute the SSIM index and mean of the contrast comparison function
-	cv::Scalar computeSSIM(const cv::Mat& img1, const cv::Mat& img2);
+	// mu1 and sq1, if given, are the filtered img1 and img1^2 computed by
+	// filterReference()
+	cv::Scalar computeSSIM(const cv::Mat& img1, const cv::Mat& img2, Workspace& ws,
+		const cv::Mat *mu1 = nullptr, const cv::Mat *sq1 = nullptr) const;
+	// Compute the means given by terms[i] of the n pairs img1[i], img2[i]
+	// in a single pass over the bands of all of them, so that small images
+	// are not dispatched to the workers one after the other
+	// The terms which are not requested are neither computed nor written.
+	// mu1 and sq1, if given, are arrays of the filtered img1 and img1^2
+	// computed by filterReference().
+	void computeMeans(int n, const cv::Mat *img1, const cv::Mat *img2, const int *terms, Workspace& ws,
+		double *mssim, double *mcs, const cv::Mat *mu1 = nullptr, const cv::Mat *sq1 = nullptr) const;
+	// Gaussian filtering of img1 and img1^2 ('valid' part)
+	void filterReference(const cv::Mat& img1, cv::Mat& mu, cv::Mat& sq, Workspace& ws) const;
+	// Same as filterReference(), the maps are shared through the feature
+	// cache of the workspace when img1 is a frame (mu and sq then refer to
+	// the cache entries)
+	void referenceMoments(const cv::Mat& img1, cv::Mat& mu, cv::Mat& sq, Workspace& ws) const;
 private:
-	cv::Mat mu1, mu2;
-	cv::Mat mu1_sq, mu2_sq, mu1_mu2;
-	cv::Mat img1_sq, img2_sq, img1_img2;
-	cv::Mat sigma1_sq, sigma2_sq, sigma12;
+	struct State;
 
-#if defined(HAVE_SSIM_BLUR_8)
-	cv::Mat bmu1, bmu2;
-	cv::Mat bmu1_sq, bmu2_sq, bmu1_mu2;
-	cv::Mat bsigma1_sq, bsigma2_sq, bsigma12;
-#endif
+	// C1 and C2 scaled to the bit depth
+	float c1, c2;
+	// Sums of the SSIM and CS maps of the output rows [y0, y1), only the
+	// sums given by terms being updated
+	void computeSSIMBand(const cv::Mat& img1, const cv::Mat& img2, const cv::Mat *mu1, const cv::Mat *sq1,
+		int y0, int y1, int terms, cv::Mat& buf, double *ssim_sum, double *cs_sum) const;
+	// Filtered img1 and img1^2 of the output rows [y0, y1)
+	void filterReferenceBand(const cv::Mat& img1, cv::Mat& mu, cv::Mat& sq, int y0, int y1, cv::Mat& buf) const;
+	// Allocate the line buffers of each worker of the workspace for images
+	// of cn channels
+	std::vector<cv::Mat>& prepareLines(Workspace& ws, int cn) const;
+
+	// Gaussian window
+	cv::Mat window;
 };
 
 #endif
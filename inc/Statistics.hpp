@@ -0,0 +1,80 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Streaming summary statistics of a metric.
+
+ The values are seen once, in any order, and are not kept: the mean and
+ the variance are updated with Welford's method, the quantiles are
+ estimated with a merging t-digest, whose centroids are bounded by its
+ compression whatever the number of values. Up to COMPRESSION values every
+ centroid holds a single value and the quantiles are exact. Two
+ statistics of disjoint sets of values merge into the statistics of their
+ union, and they may be read at any time, e.g. for running snapshots.
+
+**************************************************************************/
+
+#ifndef Statistics_hpp
+#define Statistics_hpp
+
+#include <cstddef>
+#include <vector>
+
+class Statistics {
+public:
+	// Compression of the t-digest, the number of its centroids is bounded
+	// by a small multiple of it
+	static const int COMPRESSION = 200;
+
+	Statistics();
+	void add(double value);
+	// Add the values of other
+	void merge(const Statistics& other);
+	size_t count() const;
+	double mean() const;
+	// Sample standard deviation, 0 for less than two values
+	double stddev() const;
+	// Quantile q from 0 to 1, interpolated linearly between the sorted
+	// values when they are all kept
+	double quantile(double q) const;
+private:
+	struct Centroid {
+		double mean;
+		double weight;
+	};
+	// Merge the buffered values into the centroids
+	void compress();
+	static void compress(std::vector<Centroid>& centroids, double total);
+
+	size_t n;
+	double avg;
+	double m2;		// sum of the squared differences to the mean
+	double min;
+	double max;
+	std::vector<Centroid> centroids;	// sorted by mean
+	std::vector<Centroid> buffer;		// values not merged yet
+};
+
+#endif
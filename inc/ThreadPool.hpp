@@ -0,0 +1,85 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Fixed-size pool of worker threads running parallel loops.
+
+ The iterations of a loop are split in contiguous ranges, one per worker.
+ A worker which runs out of work steals half of the remaining range of
+ another worker, so unequal iteration costs are balanced without a
+ shared queue.
+
+**************************************************************************/
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	// The calling thread is worker 0, nbthreads-1 threads are created
+	explicit ThreadPool(int nbthreads);
+	~ThreadPool();
+	int size() const { return nbthreads; }
+	// Call task(worker, i) for every i in [0, n), worker being the index of
+	// the calling worker in [0, size())
+	// Returns once all the iterations are done. When called from a task,
+	// the iterations run sequentially on the current worker.
+	void parallelFor(int n, const std::function<void(int, int)>& task);
+private:
+	// Range of iterations owned by a worker
+	struct Range {
+		std::mutex lock;
+		int begin;
+		int end;
+	};
+	// Main loop of the created threads
+	void run(int worker);
+	// Run the iterations of the current loop until there are none left
+	void work(int worker);
+	// Take the next iteration of the worker's own range
+	bool pop(int worker, int& index);
+	// Move half of the range of another worker to the worker's own range
+	bool steal(int worker, int& index);
+
+	int nbthreads;
+	std::vector<std::thread> threads;
+	Range *ranges;
+
+	std::mutex lock;
+	std::condition_variable start;	// a loop is ready for the workers
+	std::condition_variable done;	// a worker has finished the loop
+	const std::function<void(int, int)> *task;
+	unsigned generation;		// number of loops started
+	int pending;			// number of created threads still working
+	bool stop;
+};
+
+#endif
@@ -57,24 +57,28 @@
 
 #include "Metric.hpp"
 
-class VIFP : protected Metric {
+class VIFP : public Metric {
 public:
-	VIFP(int height, int width);
+	VIFP(int height, int width, int bitdepth = 8);
 	// Compute the VIFp index of the processed image
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
+	// Compute the pyramid of the original image and the local means and
+	// second moments of each scale, shared by the next calls to compute()
+	// with the same workspace
+	// The original image has to stay valid until then.
+	void setReference(const cv::Mat& original, Workspace& ws) const;
+	// Compute the VIFp index of the processed image against the reference
+	float compute(const cv::Mat& processed, Workspace& ws) const;
 private:
+	struct State;
+
 	static const int NLEVS = 4;
 	static const float SIGMA_NSQ;
 	// Compute the coefficients of the VIFp index at a particular subband
-	void computeVIFP(const cv::Mat& ref, const cv::Mat& dist, int N, double& num, double& den);
-
-	cv::Mat ref[NLEVS];
-	cv::Mat dist[NLEVS];
-	cv::Mat tmp1, tmp2;
+	void computeVIFP(State& st, int scale, int N, double& num, double& den, Workspace& ws) const;
 
-	cv::Mat tmp;
-	cv::Mat mu1, mu2, mu1_sq, mu2_sq, mu1_mu2, sigma1_sq, sigma2_sq, sigma12, g, sv_sq;
-	cv::Mat sigma1_sq_th, sigma2_sq_th, g_th;
+	// Gaussian window of each scale
+	cv::Mat window[NLEVS];
 };
 
 #endif
@@ -28,7 +28,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <string>
+#include <thread>
+#include <vector>
 #include <opencv2/core/core.hpp>
+#include "FrameRing.hpp"
 
 // _WIN32 is also defined in WIN64 environment (why on earth? => backward
 // compatibility the argue). Added this note to remember that this actually
@@ -43,12 +47,19 @@
 #include <sys/io.h>
 #endif /* __linux__ */
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* _WIN32 */
+
 #ifndef _WIN32
 // compatibility with UNIX systems as, unlike un Windows, there is no
 // difference between text and binary files: they are just sequence of bytes...
 #define O_BINARY 0
 #endif /* _WIN32 */
 
+// Raw frame data: one byte per sample up to 8 bits per sample, otherwise
+// two bytes per sample in little-endian order, in the host order once read
 typedef unsigned char imgpel;
 
 // Chroma subsampling format definitions
@@ -59,22 +70,83 @@ enum ChromaSubsampling {
 	CHROMA_SUBSAMP_444 = 3
 };
 
+// Input files are either raw YUV or YUV4MPEG2 (Y4M) streams, detected by
+// their signature. The geometry, chroma format and bit depth of Y4M
+// streams come from their header, height and width may then be 0.
 class VideoYUV {
 public:
-	VideoYUV(const char *file, int height, int width, int nbframes, int chroma_format);
+	VideoYUV(const char *file, int height, int width, int nbframes, int chroma_format, int bitdepth = 8);
 	~VideoYUV();
 	// Read one frame
 	bool readOneFrame();
+	// Read the frame with the given index (0-based)
+	// Memory-mapped inputs only move a pointer, other seekable files are
+	// repositioned before reading. The frames of Y4M files are found with
+	// an index of their offsets built when opening the file. Stream inputs
+	// are read up to the frame, which cannot be before the current one.
+	bool readFrame(int frame);
 	// Get the luma component
 	// readOneFrame() needs to be called before getLuma()
+	// With the type of the samples (CV_8UC1, or CV_16UC1 above 8 bits per
+	// sample), luma becomes a header on the frame data (no copy) which stays
+	// valid until the next call to readOneFrame()
 	void getLuma(cv::Mat& luma, int type = CV_8UC1);
-	imgpel *getFrameData() { return data; }
+	// Get a header on the given component (0: Y, 1: U, 2: V) of the current
+	// frame without copying it, of type CV_8UC1 or CV_16UC1
+	cv::Mat getPlane(int comp) const;
+	const imgpel *getFrameData() const { return luma; }
 	void getYUV(cv::Mat& yuv);
 	imgpel *getYUV();
 	void getU(cv::Mat& u);
 	void getV(cv::Mat& v);
 	size_t getRawFrameSize() const { return size; }
+	int getHeight() const { return height; }
+	int getWidth() const { return width; }
+	// Size of the U and V planes, 0 for 4:0:0
+	int getChromaHeight() const { return comp_height[1]; }
+	int getChromaWidth() const { return comp_width[1]; }
+	int getChromaFormat() const { return chf; }
+	int getBitDepth() const { return bitdepth; }
+	// Number of frames in the input file, 0 if unknown (stream input)
+	int getFrameCount() const;
+	// True if the last read failed because the input ended between two
+	// frames, as opposed to within a frame
+	bool atEnd() const { return eof; }
+	// True if the input is a Y4M stream
+	bool isY4M() const { return y4m; }
+	// True if the input file is memory-mapped instead of read with fread()
+	bool isMapped() const { return map != nullptr; }
+	// Read up to 'depth' frames ahead in a background thread, so that
+	// reading overlaps with the computation of the metrics
+	// Only stream inputs are prefetched, mapped inputs rely on the kernel
+	// read-ahead. Must be called before the first readOneFrame().
+	void startPrefetch(int depth);
 private:
+	// Parse the parameters of the Y4M stream header
+	static bool parseY4MHeader(const std::string& header, int& h, int& w, int& chroma_format, int& bd);
+	// Read one line of a Y4M stream (header or frame marker) without the newline
+	bool readLine(std::string& line);
+	// Skip the FRAME marker preceding the data of each Y4M frame
+	bool readFrameHeader();
+	// Read the data of the next frame into 'data'
+	bool readFrameData();
+	// Read n bytes of the input, starting with the bytes read ahead when
+	// looking for the Y4M signature
+	size_t readInput(imgpel *dst, size_t n);
+	// Build the offset index of the frames of a mapped or seekable Y4M file
+	void indexMapped();
+	void indexFile();
+	// Offset of the data of the given frame in the input file
+	long long frameOffset(int frame) const;
+	// Try to memory-map the whole input file
+	bool mapFile();
+	// Enlarge the buffer of a pipe input to hold a frame, where supported
+	void enlargePipe();
+	// Point luma and chroma to the given frame data
+	void setFrame(const imgpel *frame_data);
+	// Body of the prefetching thread
+	void prefetch();
+
 	FILE* file;		// file stream
 	int nbframes;		// number of frames
 	int height;		// height
@@ -82,15 +154,33 @@ private:
 	int comp_height[3];	// height in specific component
 	int comp_width[3];	// width in specific component
 
-	size_t size;		// number of samples
+	int bitdepth;		// number of bits per sample
+	int bps;		// number of bytes per sample
+	size_t size;		// number of bytes per frame
 	int comp_size[3];	// number of samples in specific component
 	bool yuv_ready;
 	int chf;
 
 	imgpel *data;		// data array
-	imgpel *luma;		// pointer to luma
-	imgpel *chroma[2];	// pointers to chroma
+	const imgpel *luma;	// pointer to luma
+	const imgpel *chroma[2];	// pointers to chroma
 	imgpel *yuv_data;
+
+	imgpel *map;		// memory-mapped file, nullptr if not mapped
+	size_t map_size;	// size of the mapping in bytes
+	int nbmapped;		// number of complete frames in the mapping
+	int frame_no;		// index of the next frame to read
+	bool eof;		// the input ended between two frames
+
+	bool seekable;		// the input file can be repositioned
+	bool y4m;		// the input is a Y4M stream
+	size_t header_size;	// size of the Y4M stream header
+	std::vector<long long> offsets;	// offsets of the Y4M frame data
+	std::string peeked;	// bytes read ahead from a raw stream input
+
+	FrameRing *ring;	// frames read ahead, nullptr if not prefetching
+	std::thread *reader;	// prefetching thread
+	bool frame_held;	// the current frame is a slot of the ring
 };
 
 #endif
@@ -31,13 +31,38 @@
 #ifndef WSPSNR_hpp
 #define WSPSNR_hpp
 
+#include <vector>
 #include "Metric.hpp"
 
-class WSPSNR : protected Metric {
+class WSPSNR : public Metric {
 public:
-	WSPSNR(int height, int width);
+	// The chroma planes are chroma_height rows high, 0 without chroma
+	// The ERP weight of each row of the luma and chroma planes,
+	// cos((j+0.5-H/2)*pi/H), is computed once here.
+	WSPSNR(int height, int width, int chroma_height, int bitdepth = 8);
 	// Compute the WSPSNR index of the processed image
-	float compute(const cv::Mat& original, const cv::Mat& processed);
+	float compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
+	// Compute the WSPSNR index of the luma plane of samples (CV_8UC1 or
+	// CV_16UC1)
+	float compute(const cv::Mat& original, const cv::Mat& processed) const;
+	// Compute the WSPSNR index of each of the Y, U and V planes of samples,
+	// stored in planes, and return the WSPSNR of their weighted mean
+	// squared errors weighted by weights
+	// Empty planes (4:0:0) are left out, their WSPSNR is 0.
+	float compute(const cv::Mat *original, const cv::Mat *processed, const double *weights, float *planes) const;
+private:
+	// Row weights of the luma and chroma planes
+	std::vector<double> luma_weights;
+	std::vector<double> chroma_weights;
+
+	// Row weights of a plane of the given height
+	static std::vector<double> rowWeights(int rows);
+	// Mean of the squared errors of two planes of samples weighted by the
+	// weights of their rows, the squared errors of each row being summed
+	// with integers
+	static double weightedMSE(const cv::Mat& a, const cv::Mat& b, const std::vector<double>& weights);
+	// WSPSNR index of a weighted mean squared error
+	float fromMSE(double mse) const;
 };
 
 #endif
@@ -44,17 +44,21 @@
 
 #include "Metric.hpp"
 
-class WSSSIM : protected Metric {
+class WSSSIM : public Metric {
 public:
-    WSSSIM (int height, int width);
+    WSSSIM (int height, int width, int bitdepth = 8);
     // Compute the WSSSIM index of the processed image.
-    float compute (const cv::Mat& original, const cv::Mat& processed);
+    float compute (const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const;
 protected:
     // Compute the WSSSIM index and mean of the contrast comparison function.
-    cv::Scalar computeWSSSIM (const cv::Mat& img1, const cv::Mat& img2);
+    cv::Scalar computeWSSSIM (const cv::Mat& img1, const cv::Mat& img2, Workspace& ws) const;
 private:
+    struct State;
+
     static const double C1;
     static const double C2;
+    // Gaussian window
+    cv::Mat window;
 };
 
 #endif
@@ -0,0 +1,132 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Buffers and per-frame state used by the metrics.
+
+ The metrics do not modify themselves when computing an index: everything
+ they need to write goes to the workspace given by the caller. One metric
+ object can thus be used by several threads at once, each with its own
+ workspace, and a workspace can be reused for any number of frames and
+ metrics so that its buffers are only allocated once.
+
+ The buffers which only live during the computation of a frame are taken
+ from the arena of the workspace, released by clear() before each frame.
+
+**************************************************************************/
+
+#ifndef Workspace_hpp
+#define Workspace_hpp
+
+#include <cstddef>
+#include <vector>
+#include "Arena.hpp"
+
+class FeatureCache;
+class ThreadPool;
+
+class Workspace {
+public:
+	// State of one metric in the workspace, derived by the metrics
+	struct State {
+		virtual ~State();
+	};
+
+	Workspace();
+	~Workspace();
+	// Release the scratch memory of the previous frame, to be called before
+	// computing the metrics of a new frame
+	void clear();
+	// Scratch memory of the current frame
+	// Not thread-safe: the metrics take the buffers of all the bands before
+	// starting parallel work.
+	Arena& getArena()
+	{
+		return arena;
+	}
+	// Features shared by the metrics computed with this workspace, to be
+	// cleared by the caller before each new frame (default: nullptr, no
+	// sharing)
+	void setCache(FeatureCache *cache);
+	FeatureCache *getCache() const;
+	// Threads computing the bands of the frames (default: nullptr, the
+	// bands are computed sequentially)
+	void setThreadPool(ThreadPool *pool);
+	ThreadPool *getThreadPool() const;
+	// Return the state of type T of the metric owner, created on first use
+	// Not thread-safe: the metrics look their state up before starting
+	// parallel work.
+	template <class T> T& state(const void *owner);
+	// Return the state of type T of the metric owner, nullptr if it has
+	// not been created
+	template <class T> const T *find(const void *owner) const;
+private:
+	Workspace(const Workspace&) = delete;
+	Workspace& operator=(const Workspace&) = delete;
+
+	// Address unique to the type T
+	template <class T> static const void *typeTag()
+	{
+		static const char tag = 0;
+		return &tag;
+	}
+
+	struct Entry {
+		const void *owner;
+		const void *type;	// address unique to the type of the state
+		State *state;
+	};
+	std::vector<Entry> entries;
+	Arena arena;
+	FeatureCache *cache;
+	ThreadPool *pool;
+};
+
+template <class T> T& Workspace::state(const void *owner)
+{
+	const void *type = typeTag<T>();
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].owner == owner && entries[i].type == type) {
+			return *static_cast<T*>(entries[i].state);
+		}
+	}
+	T *s = new T();
+	Entry e = {owner, type, s};
+	entries.push_back(e);
+	return *s;
+}
+
+template <class T> const T *Workspace::find(const void *owner) const
+{
+	const void *type = typeTag<T>();
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].owner == owner && entries[i].type == type) {
+			return static_cast<const T*>(entries[i].state);
+		}
+	}
+	return nullptr;
+}
+
+#endif
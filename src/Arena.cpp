@@ -0,0 +1,149 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include "Arena.hpp"
+#ifndef _WIN32
+#include <sys/mman.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace {
+	// Size of the first block
+	const size_t MIN_BLOCK_SIZE = 1 << 20;
+	// Size of the transparent huge pages, to which huge blocks are rounded
+	const size_t HUGE_PAGE_SIZE = 2 << 20;
+}
+
+Arena::Arena() : current(0), offset(0), nballocated(0), huge_pages(false)
+{
+}
+
+Arena::~Arena()
+{
+	for (size_t i = 0; i < blocks.size(); i++) {
+		freeBlock(blocks[i]);
+	}
+}
+
+void Arena::setHugePages(bool enable)
+{
+	huge_pages = enable;
+}
+
+void *Arena::allocate(size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	while (current < blocks.size() && offset + size > blocks[current].size) {
+		current++;
+		offset = 0;
+	}
+	if (current == blocks.size()) {
+		grow(size);
+	}
+	char *p = blocks[current].data + offset;
+	offset += size;
+	return p;
+}
+
+cv::Mat Arena::mat(int rows, int cols, int type)
+{
+	const size_t size = static_cast<size_t>(rows) * static_cast<size_t>(cols) * static_cast<size_t>(CV_ELEM_SIZE(type));
+	return cv::Mat(rows, cols, type, allocate(size));
+}
+
+void Arena::reset()
+{
+	// Replace the blocks by a single one as large as all of them, which
+	// holds the allocations of the next frames
+	if (blocks.size() > 1) {
+		size_t total = 0;
+		for (size_t i = 0; i < blocks.size(); i++) {
+			total += blocks[i].size;
+			freeBlock(blocks[i]);
+		}
+		blocks.clear();
+		grow(total);
+	}
+	current = 0;
+	offset = 0;
+}
+
+size_t Arena::blockCount() const
+{
+	return nballocated;
+}
+
+void Arena::grow(size_t size)
+{
+	size_t block_size = blocks.empty() ? MIN_BLOCK_SIZE : 2 * blocks.back().size;
+	while (block_size < size) {
+		block_size *= 2;
+	}
+	blocks.push_back(allocateBlock(block_size));
+	nballocated++;
+	current = blocks.size() - 1;
+	offset = 0;
+}
+
+Arena::Block Arena::allocateBlock(size_t size) const
+{
+	Block block;
+	block.size = size;
+#ifndef _WIN32
+	if (huge_pages && size >= HUGE_PAGE_SIZE) {
+		block.size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	}
+	// Anonymous mappings are page-aligned
+	void *p = mmap(nullptr, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "Error: cannot allocate %zu bytes of workspace\n", block.size);
+		exit(EXIT_FAILURE);
+	}
+#ifdef MADV_HUGEPAGE
+	if (huge_pages && block.size >= HUGE_PAGE_SIZE) {
+		madvise(p, block.size, MADV_HUGEPAGE);
+	}
+#endif
+	block.data = static_cast<char*>(p);
+#else
+	block.data = static_cast<char*>(_aligned_malloc(size, ALIGNMENT));
+	if (block.data == nullptr) {
+		fprintf(stderr, "Error: cannot allocate %zu bytes of workspace\n", size);
+		exit(EXIT_FAILURE);
+	}
+#endif
+	return block;
+}
+
+void Arena::freeBlock(const Block& block)
+{
+#ifndef _WIN32
+	munmap(block.data, block.size);
+#else
+	_aligned_free(block.data);
+#endif
+}
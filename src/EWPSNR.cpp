@@ -30,7 +30,11 @@
 
 #define PI 3.14159265
 
-EWPSNR::EWPSNR(int h, int w) : Metric(h, w)
+struct EWPSNR::State : Workspace::State {
+	unsigned int frame_no = 0;
+};
+
+EWPSNR::EWPSNR(int h, int w, int bitdepth) : Metric(h, w, CV_32F, bitdepth)
 {
 //	m_eye_track_data["bus"] = "/data/SFU_etdb/CSV/bus-Screen.csv";
 //    m_eye_track_data["city"] = "/data/SFU_etdb/CSV/city-Screen.csv";
@@ -46,30 +50,42 @@ EWPSNR::EWPSNR(int h, int w) : Metric(h, w)
 //    m_eye_track_data["tempete"] = "/data/SFU_etdb/CSV/tempete-Screen.csv";
 }
 
-float EWPSNR::compute(const cv::Mat& original, const cv::Mat& processed)
+void EWPSNR::set_frame_no(Workspace& ws, unsigned int no) const
+{
+	ws.state<State>(this).frame_no = no;
+}
+
+float EWPSNR::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const
 {
-    cv::Mat w(original.size(), CV_32FC1);
-    compute_eye_weight(w);
-	return WPSNR(original, processed, w);
+	const State& st = ws.state<State>(this);
+    cv::Mat w = ws.getArena().mat(original.rows, original.cols, CV_32FC1);
+    compute_eye_weight(w, st.frame_no);
+	return WPSNR(original, processed, w, ws);
 }
 
-float EWPSNR::WPSNR(const cv::Mat& original, const cv::Mat& processed, const cv::Mat& w)
+float EWPSNR::WPSNR(const cv::Mat& original, const cv::Mat& processed, const cv::Mat& w, Workspace& ws) const
 {
-	cv::Mat tmp(height,width,CV_32F);
-	cv::subtract(original, processed, tmp);
-	cv::multiply(tmp, tmp, tmp);
-	cv::multiply(tmp, w, tmp);
-	return float(10*log10(255*255/(cv::mean(tmp).val[0]*original.cols*original.rows)));
+	FeatureCache *cache = ws.getCache();
+	cv::Mat tmp = ws.getArena().mat(height,width,CV_32F);
+	if (cache != nullptr) {
+		cv::multiply(cache->squaredError(original, processed), w, tmp);
+	}
+	else {
+		cv::subtract(original, processed, tmp);
+		cv::multiply(tmp, tmp, tmp);
+		cv::multiply(tmp, w, tmp);
+	}
+	return float(10*log10(static_cast<double>(peak)*static_cast<double>(peak)/(cv::mean(tmp).val[0]*original.cols*original.rows)));
 }
 
-void EWPSNR::compute_eye_weight(cv::Mat &w)
+void EWPSNR::compute_eye_weight(cv::Mat &w, unsigned int frame_no) const
 {
     float sum = 0;
     for (int i=0; i<w.rows; i++) {
         for (int j=0; j<w.cols; j++) {
             float* data = w.ptr<float>(i, j);
             *data = 0;
-            for (auto &p: m_gazes[m_frame_no]) {
+            for (auto &p: m_gazes[frame_no]) {
                 *data += static_cast<float>(retina_gaussian(j, i, p.first, p.second, 64, 64));
             }
             sum += *data;
@@ -93,7 +109,7 @@ bool EWPSNR::match_eye_track_data(std::string filename)
         if(filename.find(i.first) != std::string::npos) {
             m_id = i.first;
             m_path = i.second;
-            if ( load_eye_track_data() ) {
+            if ( load_eye_track_data(m_path) ) {
                 return true;
             } else {
                 return false;
@@ -103,10 +119,10 @@ bool EWPSNR::match_eye_track_data(std::string filename)
     return false;
 }
 
-bool EWPSNR::load_eye_track_data()
+bool EWPSNR::load_eye_track_data(const std::string& path)
 {
     try {
-        std::ifstream csv(m_path);
+        std::ifstream csv(path);
         std::string buffer;
         std::getline(csv, buffer);
         std::getline(csv, buffer);
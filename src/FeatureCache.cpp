@@ -0,0 +1,102 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "FeatureCache.hpp"
+
+FeatureCache::FeatureCache() : used(0)
+{
+}
+
+void FeatureCache::clear()
+{
+	used = 0;
+}
+
+const cv::Mat& FeatureCache::product(const cv::Mat& a, const cv::Mat& b)
+{
+	bool found;
+	Entry& e = lookup(FEATURE_PRODUCT, a, b, 0, 0.0, found);
+	if (!found) {
+		cv::multiply(a, b, e.mat[0]);
+	}
+	return e.mat[0];
+}
+
+const cv::Mat& FeatureCache::squaredError(const cv::Mat& a, const cv::Mat& b)
+{
+	bool found;
+	Entry& e = lookup(FEATURE_SQUARED_ERROR, a, b, 0, 0.0, found);
+	if (!found) {
+		cv::subtract(a, b, e.mat[0]);
+		cv::multiply(e.mat[0], e.mat[0], e.mat[0]);
+	}
+	return e.mat[0];
+}
+
+bool FeatureCache::moments(const cv::Mat& img, int ksize, double sigma, cv::Mat*& mu, cv::Mat*& sq)
+{
+	bool found;
+	Entry& e = lookup(FEATURE_MOMENTS, img, img, ksize, sigma, found);
+	mu = &e.mat[0];
+	sq = &e.mat[1];
+	return found;
+}
+
+FeatureCache::Entry& FeatureCache::lookup(int feature, const cv::Mat& a, const cv::Mat& b, int ksize, double sigma, bool& found)
+{
+	// The product is symmetric
+	const unsigned char *pa = a.data;
+	const unsigned char *pb = b.data;
+	if (feature == FEATURE_PRODUCT && pb < pa) {
+		std::swap(pa, pb);
+	}
+
+	for (size_t i = 0; i < used; i++) {
+		Entry& e = entries[i];
+		if (e.feature == feature && e.a == pa && e.b == pb && e.rows == a.rows && e.cols == a.cols
+			&& e.type == a.type() && e.ksize == ksize && fabs(e.sigma - sigma) <= DBL_EPSILON) {
+			found = true;
+			return e;
+		}
+	}
+
+	// Reuse the buffers of an entry of a previous frame if any
+	if (used == entries.size()) {
+		entries.push_back(Entry());
+	}
+	Entry& e = entries[used++];
+	e.feature = feature;
+	e.a = pa;
+	e.b = pb;
+	e.rows = a.rows;
+	e.cols = a.cols;
+	e.type = a.type();
+	e.ksize = ksize;
+	e.sigma = sigma;
+	found = false;
+	return e;
+}
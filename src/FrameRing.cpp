@@ -0,0 +1,107 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <chrono>
+#include <thread>
+#include "FrameRing.hpp"
+
+FrameRing::FrameRing(size_t frame_size, int n) :
+  nbslots(static_cast<unsigned>(n)), head(0), tail(0), finished(false), closed(false)
+{
+	slots = new unsigned char*[nbslots];
+	for (unsigned i = 0; i < nbslots; i++) {
+		slots[i] = new unsigned char[frame_size];
+	}
+}
+
+FrameRing::~FrameRing()
+{
+	for (unsigned i = 0; i < nbslots; i++) {
+		delete[] slots[i];
+	}
+	delete[] slots;
+}
+
+void FrameRing::backoff(int& spins)
+{
+	// Spin for short waits, sleep when the other side is clearly busy
+	// (reading from a slow pipe or computing metrics)
+	if (++spins < 64) {
+		std::this_thread::yield();
+	}
+	else {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+unsigned char *FrameRing::acquireFree()
+{
+	unsigned t = tail.load(std::memory_order_relaxed);
+	int spins = 0;
+	while (t - head.load(std::memory_order_acquire) == nbslots) {
+		if (closed.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		backoff(spins);
+	}
+	if (closed.load(std::memory_order_acquire)) {
+		return nullptr;
+	}
+	return slots[t % nbslots];
+}
+
+void FrameRing::publish()
+{
+	tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void FrameRing::finish()
+{
+	finished.store(true, std::memory_order_release);
+}
+
+const unsigned char *FrameRing::acquireReady()
+{
+	unsigned h = head.load(std::memory_order_relaxed);
+	int spins = 0;
+	while (tail.load(std::memory_order_acquire) == h) {
+		// 'finished' is set after the last publish(): check 'tail' again
+		// to not miss the last frame
+		if (finished.load(std::memory_order_acquire) && tail.load(std::memory_order_acquire) == h) {
+			return nullptr;
+		}
+		backoff(spins);
+	}
+	return slots[h % nbslots];
+}
+
+void FrameRing::release()
+{
+	head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void FrameRing::close()
+{
+	closed.store(true, std::memory_order_release);
+}
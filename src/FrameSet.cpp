@@ -0,0 +1,49 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include "FrameSet.hpp"
+
+void FrameSet::allocate(int height, int width, int chroma_height, int chroma_width, bool luma, bool chroma,
+	size_t nbprocessed)
+{
+	if (luma) {
+		original.create(height, width, CV_32F);
+	}
+	if (chroma) {
+		original_chroma[0].create(chroma_height, chroma_width, CV_32F);
+		original_chroma[1].create(chroma_height, chroma_width, CV_32F);
+	}
+	processed.resize(nbprocessed);
+	processed_chroma.resize(2 * nbprocessed);
+	processed_planes.resize(3 * nbprocessed);
+	for (size_t i = 0; i < nbprocessed; i++) {
+		if (luma) {
+			processed[i].create(height, width, CV_32F);
+		}
+		if (chroma) {
+			processed_chroma[2 * i].create(chroma_height, chroma_width, CV_32F);
+			processed_chroma[2 * i + 1].create(chroma_height, chroma_width, CV_32F);
+		}
+	}
+}
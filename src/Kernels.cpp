@@ -0,0 +1,1338 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string.h>
+#include "Kernels.hpp"
+
+// The x86 variants are compiled with per-function target attributes, so
+// the rest of the program does not depend on -march
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#else
+#define HAVE_X86_KERNELS 0
+#endif
+
+namespace {
+	const float VIF_EPSILON = 1e-10f;
+	// Natural logarithm of the vectorized kernels (Cephes logf): x = m*2^e
+	// with m in [sqrt(2)/2, sqrt(2)), ln(m) from a polynomial in m-1, for
+	// positive normal x, within 2 ulp
+	const float LOG_SQRTHF = 0.707106781186547524f;
+	const float LOG_P[9] = {7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f, -1.2420140846e-1f,
+		1.4249322787e-1f, -1.6668057665e-1f, 2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f};
+	const float LOG_Q1 = -2.12194440e-4f;
+	const float LOG_Q2 = 0.693359375f;
+	// Number of vectors of 8-bit samples whose squared differences are
+	// summed in 32-bit lanes before being widened to 64 bits: each lane
+	// gains at most 4*255^2 per vector, which keeps the sums below 2^31
+	const int U8_BLOCK = 8192;
+	// Multipliers of the 8-point DCT of Loeffler, Ligtenberg and Moschytz,
+	// as factored in the islow DCT of libjpeg, whose outputs are those of
+	// the orthonormal DCT scaled by sqrt(8)
+	const float DCT_0_298631336 = 0.298631336f;
+	const float DCT_0_390180644 = 0.390180644f;
+	const float DCT_0_541196100 = 0.541196100f;
+	const float DCT_0_765366865 = 0.765366865f;
+	const float DCT_0_899976223 = 0.899976223f;
+	const float DCT_1_175875602 = 1.175875602f;
+	const float DCT_1_501321110 = 1.501321110f;
+	const float DCT_1_847759065 = 1.847759065f;
+	const float DCT_1_961570561 = 1.961570561f;
+	const float DCT_2_053119869 = 2.053119869f;
+	const float DCT_2_562915448 = 2.562915448f;
+	const float DCT_3_072711027 = 3.072711027f;
+	// Scale of the 2D DCT made of two such passes
+	const float DCT_SCALE = 0.125f;
+
+	/*
+	 * Generic versions, also used for the tails of the vectorized loops
+	 */
+
+	double sumSquaredDiffGeneric(const float *a, const float *b, int n)
+	{
+		double sum = 0.0;
+		for (int i = 0; i < n; i++) {
+			float d = a[i] - b[i];
+			sum += static_cast<double>(d * d);
+		}
+		return sum;
+	}
+
+	template <typename T> uint64_t sumSquaredDiffIntGeneric(const T *a, const T *b, int n)
+	{
+		uint64_t sum = 0;
+		for (int i = 0; i < n; i++) {
+			int64_t d = static_cast<int64_t>(a[i]) - static_cast<int64_t>(b[i]);
+			sum += static_cast<uint64_t>(d * d);
+		}
+		return sum;
+	}
+
+	uint64_t sumSquaredDiffU8Generic(const unsigned char *a, const unsigned char *b, int n)
+	{
+		return sumSquaredDiffIntGeneric(a, b, n);
+	}
+
+	uint64_t sumSquaredDiffU16Generic(const unsigned short *a, const unsigned short *b, int n)
+	{
+		return sumSquaredDiffIntGeneric(a, b, n);
+	}
+
+	// 8-point DCT of v[0], v[step], ..., v[7*step] in place, scaled by sqrt(8)
+	void dct8Generic(float *v, int step)
+	{
+		float tmp0 = v[0] + v[7*step];
+		float tmp7 = v[0] - v[7*step];
+		float tmp1 = v[step] + v[6*step];
+		float tmp6 = v[step] - v[6*step];
+		float tmp2 = v[2*step] + v[5*step];
+		float tmp5 = v[2*step] - v[5*step];
+		float tmp3 = v[3*step] + v[4*step];
+		float tmp4 = v[3*step] - v[4*step];
+
+		// Even part
+		float tmp10 = tmp0 + tmp3;
+		float tmp13 = tmp0 - tmp3;
+		float tmp11 = tmp1 + tmp2;
+		float tmp12 = tmp1 - tmp2;
+		v[0] = tmp10 + tmp11;
+		v[4*step] = tmp10 - tmp11;
+		float z1 = (tmp12 + tmp13) * DCT_0_541196100;
+		v[2*step] = z1 + tmp13 * DCT_0_765366865;
+		v[6*step] = z1 - tmp12 * DCT_1_847759065;
+
+		// Odd part
+		z1 = tmp4 + tmp7;
+		float z2 = tmp5 + tmp6;
+		float z3 = tmp4 + tmp6;
+		float z4 = tmp5 + tmp7;
+		float z5 = (z3 + z4) * DCT_1_175875602;
+		tmp4 *= DCT_0_298631336;
+		tmp5 *= DCT_2_053119869;
+		tmp6 *= DCT_3_072711027;
+		tmp7 *= DCT_1_501321110;
+		z1 *= DCT_0_899976223;
+		z2 *= DCT_2_562915448;
+		z3 = z5 - z3 * DCT_1_961570561;
+		z4 = z5 - z4 * DCT_0_390180644;
+		v[7*step] = tmp4 - z1 + z3;
+		v[5*step] = tmp5 - z2 + z4;
+		v[3*step] = tmp6 - z2 + z3;
+		v[step] = tmp7 - z1 + z4;
+	}
+
+	// vari() of the reference code from the sum and the sum of squares of
+	// its n samples: d=var(AA(:))*length(AA(:));
+	float hvsVariance(double sum, double sq, double n)
+	{
+		return static_cast<float>(std::max(sq - sum * sum / n, 0.0) * n / (n - 1.0));
+	}
+
+	// maskeff() of the reference code from the masked energy m of the AC
+	// coefficients of a block and the sums and sums of squares of its 4x4
+	// quarters (top-left, top-right, bottom-left and bottom-right)
+	float hvsMask(float m, const double *sum, const double *sq)
+	{
+		// pop=vari(z);
+		float pop = hvsVariance(sum[0] + sum[1] + sum[2] + sum[3], sq[0] + sq[1] + sq[2] + sq[3], 64.0);
+		// if pop ~= 0: pop=(vari(z(1:4,1:4))+vari(z(1:4,5:8))+vari(z(5:8,5:8))+vari(z(5:8,1:4)))/pop;
+		if (std::abs(pop) > FLT_EPSILON) {
+			pop = (hvsVariance(sum[0], sq[0], 16.0) + hvsVariance(sum[1], sq[1], 16.0)
+				+ hvsVariance(sum[3], sq[3], 16.0) + hvsVariance(sum[2], sq[2], 16.0)) / pop;
+		}
+		// m = sqrt(m*pop)/32;
+		return std::sqrt(m * pop) / 32.0f;
+	}
+
+	void hvsTransformGeneric(const float *src, size_t stride, int n, const float *mask_table,
+		float *dct, float *mask)
+	{
+		for (int j = 0; j < n; j++) {
+			const float *z = src + 8 * static_cast<size_t>(j);
+			float *zdct = dct + 64 * static_cast<size_t>(j);
+			double sum[4] = {0.0, 0.0, 0.0, 0.0};
+			double sq[4] = {0.0, 0.0, 0.0, 0.0};
+			for (int k = 0; k < 8; k++) {
+				const float *row = z + static_cast<size_t>(k) * stride;
+				for (int l = 0; l < 8; l++) {
+					// Sums and sums of squares of the samples of each quarter
+					double a = static_cast<double>(row[l]);
+					int quarter = (k / 4) * 2 + l / 4;
+					sum[quarter] += a;
+					sq[quarter] += a * a;
+					zdct[8*k + l] = row[l];
+				}
+			}
+
+			// zdct = dct2(z); (columns, then rows)
+			for (int l = 0; l < 8; l++) {
+				dct8Generic(zdct + l, 8);
+			}
+			for (int k = 0; k < 8; k++) {
+				dct8Generic(zdct + 8*k, 1);
+			}
+
+			float m = 0.0f;
+			for (int i = 0; i < 64; i++) {
+				zdct[i] *= DCT_SCALE;
+				// if (k~=1) | (l~=1): m = m + (zdct(k,l).^2) * mask(k,l);
+				if (i != 0) {
+					m += zdct[i] * zdct[i] * mask_table[i];
+				}
+			}
+			mask[j] = hvsMask(m, sum, sq);
+		}
+	}
+
+	void hvsBlockGeneric(const float *a, const float *b, const float *csf, const float *mask_table,
+		float mask, double& s1, double& s2)
+	{
+		float b1 = 0.0f;
+		float b2 = 0.0f;
+		for (int i = 0; i < 64; i++) {
+			// u = abs(a_dct(k,l)-b_dct(k,l));
+			float u = std::abs(a[i] - b[i]);
+			// s2 = s2 + (u*CSF(k,l)).^2;
+			float tmp = u * csf[i];
+			b2 += tmp * tmp;
+			// if (k~=1) | (l~=1)
+			if (i != 0) {
+				// if u < mask_a/mask(k,l): u = 0; else u = u - mask_a/mask(k,l);
+				tmp = mask / mask_table[i];
+				u = u < tmp ? 0.0f : u - tmp;
+			}
+			// s1 = s1 + (u*CSF(k,l)).^2;
+			tmp = u * csf[i];
+			b1 += tmp * tmp;
+		}
+		s1 += static_cast<double>(b1);
+		s2 += static_cast<double>(b2);
+	}
+
+	void vifLogSumsGeneric(const float *mu1, const float *mu2, const float *e11, const float *e22,
+		const float *e12, float sigma_nsq, int n, double& num, double& den)
+	{
+		for (int i = 0; i < n; i++) {
+			// sigma1_sq(sigma1_sq<0)=0; sigma2_sq(sigma2_sq<0)=0;
+			float sigma1_sq = std::max(e11[i] - mu1[i] * mu1[i], 0.0f);
+			float sigma2_sq = std::max(e22[i] - mu2[i] * mu2[i], 0.0f);
+			float sigma12 = e12[i] - mu1[i] * mu2[i];
+			// g=sigma12./(sigma1_sq+1e-10);
+			float g = sigma12 / (sigma1_sq + VIF_EPSILON);
+			// sv_sq=sigma2_sq-g.*sigma12;
+			float sv_sq = sigma2_sq - g * sigma12;
+			// g(sigma1_sq<1e-10)=0; sv_sq(sigma1_sq<1e-10)=sigma2_sq(sigma1_sq<1e-10); sigma1_sq(sigma1_sq<1e-10)=0;
+			if (!(sigma1_sq > VIF_EPSILON)) {
+				g = 0.0f;
+				sv_sq = sigma2_sq;
+				sigma1_sq = 0.0f;
+			}
+			// g(sigma2_sq<1e-10)=0; sv_sq(sigma2_sq<1e-10)=0;
+			if (!(sigma2_sq > VIF_EPSILON)) {
+				g = 0.0f;
+				sv_sq = 0.0f;
+			}
+			// sv_sq(g<0)=sigma2_sq(g<0); g(g<0)=0;
+			if (!(g > 0.0f)) {
+				sv_sq = sigma2_sq;
+				g = 0.0f;
+			}
+			// sv_sq(sv_sq<=1e-10)=1e-10;
+			sv_sq = std::max(sv_sq, VIF_EPSILON);
+			num += static_cast<double>(std::log(1.0f + g * g * sigma1_sq / (sv_sq + sigma_nsq)));
+			den += static_cast<double>(std::log(1.0f + sigma1_sq / sigma_nsq));
+		}
+	}
+
+#if HAVE_X86_KERNELS
+	// Multiplier of the masking thresholds of the first 8 coefficients:
+	// the DC coefficient is not masked
+	const float HVS_DC[8] = {0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+
+	/*
+	 * SSE4.2 versions
+	 */
+
+	TARGET("sse4.2")
+	float hsum128(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_add_ss(v, _mm_movehdup_ps(v));
+		return _mm_cvtss_f32(v);
+	}
+
+	TARGET("sse4.2")
+	double sumSquaredDiffSSE42(const float *a, const float *b, int n)
+	{
+		__m128d acc0 = _mm_setzero_pd();
+		__m128d acc1 = _mm_setzero_pd();
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+			d = _mm_mul_ps(d, d);
+			acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(d));
+			acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(d, d)));
+		}
+		acc0 = _mm_add_pd(acc0, acc1);
+		acc0 = _mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0));
+		return _mm_cvtsd_f64(acc0) + sumSquaredDiffGeneric(a + i, b + i, n - i);
+	}
+
+	TARGET("sse4.2")
+	uint64_t hsum128(__m128i v)
+	{
+		uint64_t lanes[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+		return lanes[0] + lanes[1];
+	}
+
+	TARGET("sse4.2")
+	uint64_t sumSquaredDiffU8SSE42(const unsigned char *a, const unsigned char *b, int n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = _mm_setzero_si128();
+		int i = 0;
+		while (i + 16 <= n) {
+			const int end = std::min(n, i + 16 * U8_BLOCK);
+			__m128i sum = _mm_setzero_si128();
+			for (; i + 16 <= end; i += 16) {
+				__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+				__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+				__m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+				__m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(lo, lo));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(hi, hi));
+			}
+			acc = _mm_add_epi64(acc, _mm_cvtepu32_epi64(sum));
+			acc = _mm_add_epi64(acc, _mm_cvtepu32_epi64(_mm_srli_si128(sum, 8)));
+		}
+		return hsum128(acc) + sumSquaredDiffU8Generic(a + i, b + i, n - i);
+	}
+
+	TARGET("sse4.2")
+	uint64_t sumSquaredDiffU16SSE42(const unsigned short *a, const unsigned short *b, int n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = _mm_setzero_si128();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			// |a-b| from the saturated differences in both directions, its
+			// square taking up to 32 bits, multiplied as 64-bit lanes
+			__m128i d = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+			__m128i lo = _mm_unpacklo_epi16(d, zero);
+			__m128i hi = _mm_unpackhi_epi16(d, zero);
+			acc = _mm_add_epi64(acc, _mm_mul_epu32(lo, lo));
+			acc = _mm_add_epi64(acc, _mm_mul_epu32(hi, hi));
+			lo = _mm_srli_epi64(lo, 32);
+			hi = _mm_srli_epi64(hi, 32);
+			acc = _mm_add_epi64(acc, _mm_mul_epu32(lo, lo));
+			acc = _mm_add_epi64(acc, _mm_mul_epu32(hi, hi));
+		}
+		return hsum128(acc) + sumSquaredDiffU16Generic(a + i, b + i, n - i);
+	}
+
+	TARGET("sse4.2")
+	double hsum128(__m128d v)
+	{
+		return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+	}
+
+	// dct8Generic() of the 8 vectors, lane by lane
+	TARGET("sse4.2")
+	void dct8x128(__m128 *v)
+	{
+		__m128 tmp0 = _mm_add_ps(v[0], v[7]);
+		__m128 tmp7 = _mm_sub_ps(v[0], v[7]);
+		__m128 tmp1 = _mm_add_ps(v[1], v[6]);
+		__m128 tmp6 = _mm_sub_ps(v[1], v[6]);
+		__m128 tmp2 = _mm_add_ps(v[2], v[5]);
+		__m128 tmp5 = _mm_sub_ps(v[2], v[5]);
+		__m128 tmp3 = _mm_add_ps(v[3], v[4]);
+		__m128 tmp4 = _mm_sub_ps(v[3], v[4]);
+
+		// Even part
+		__m128 tmp10 = _mm_add_ps(tmp0, tmp3);
+		__m128 tmp13 = _mm_sub_ps(tmp0, tmp3);
+		__m128 tmp11 = _mm_add_ps(tmp1, tmp2);
+		__m128 tmp12 = _mm_sub_ps(tmp1, tmp2);
+		v[0] = _mm_add_ps(tmp10, tmp11);
+		v[4] = _mm_sub_ps(tmp10, tmp11);
+		__m128 z1 = _mm_mul_ps(_mm_add_ps(tmp12, tmp13), _mm_set1_ps(DCT_0_541196100));
+		v[2] = _mm_add_ps(z1, _mm_mul_ps(tmp13, _mm_set1_ps(DCT_0_765366865)));
+		v[6] = _mm_sub_ps(z1, _mm_mul_ps(tmp12, _mm_set1_ps(DCT_1_847759065)));
+
+		// Odd part
+		z1 = _mm_add_ps(tmp4, tmp7);
+		__m128 z2 = _mm_add_ps(tmp5, tmp6);
+		__m128 z3 = _mm_add_ps(tmp4, tmp6);
+		__m128 z4 = _mm_add_ps(tmp5, tmp7);
+		__m128 z5 = _mm_mul_ps(_mm_add_ps(z3, z4), _mm_set1_ps(DCT_1_175875602));
+		tmp4 = _mm_mul_ps(tmp4, _mm_set1_ps(DCT_0_298631336));
+		tmp5 = _mm_mul_ps(tmp5, _mm_set1_ps(DCT_2_053119869));
+		tmp6 = _mm_mul_ps(tmp6, _mm_set1_ps(DCT_3_072711027));
+		tmp7 = _mm_mul_ps(tmp7, _mm_set1_ps(DCT_1_501321110));
+		z1 = _mm_mul_ps(z1, _mm_set1_ps(DCT_0_899976223));
+		z2 = _mm_mul_ps(z2, _mm_set1_ps(DCT_2_562915448));
+		z3 = _mm_sub_ps(z5, _mm_mul_ps(z3, _mm_set1_ps(DCT_1_961570561)));
+		z4 = _mm_sub_ps(z5, _mm_mul_ps(z4, _mm_set1_ps(DCT_0_390180644)));
+		v[7] = _mm_add_ps(_mm_sub_ps(tmp4, z1), z3);
+		v[5] = _mm_add_ps(_mm_sub_ps(tmp5, z2), z4);
+		v[3] = _mm_add_ps(_mm_sub_ps(tmp6, z2), z3);
+		v[1] = _mm_add_ps(_mm_sub_ps(tmp7, z1), z4);
+	}
+
+	// Transpose the 8x8 block whose row k is l[k] (columns 0-3) and r[k]
+	// (columns 4-7)
+	TARGET("sse4.2")
+	void transpose8x128(__m128 *l, __m128 *r)
+	{
+		_MM_TRANSPOSE4_PS(l[0], l[1], l[2], l[3]);
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+		_MM_TRANSPOSE4_PS(l[4], l[5], l[6], l[7]);
+		_MM_TRANSPOSE4_PS(r[4], r[5], r[6], r[7]);
+		for (int k = 0; k < 4; k++) {
+			std::swap(r[k], l[k+4]);
+		}
+	}
+
+	TARGET("sse4.2")
+	void hvsTransformSSE42(const float *src, size_t stride, int n, const float *mask_table,
+		float *dct, float *mask)
+	{
+		const __m128 scale = _mm_set1_ps(DCT_SCALE);
+		// Left and right halves of each row of MASK(k,l), but the DC one
+		__m128 table[16];
+		for (int k = 0; k < 8; k++) {
+			table[2*k] = _mm_loadu_ps(mask_table + 8*k);
+			table[2*k+1] = _mm_loadu_ps(mask_table + 8*k + 4);
+		}
+		table[0] = _mm_mul_ps(table[0], _mm_loadu_ps(HVS_DC));
+
+		for (int j = 0; j < n; j++) {
+			const float *z = src + 8 * static_cast<size_t>(j);
+			float *zdct = dct + 64 * static_cast<size_t>(j);
+			__m128 l[8], r[8];
+			__m128d s[4], q[4];
+			for (int i = 0; i < 4; i++) {
+				s[i] = q[i] = _mm_setzero_pd();
+			}
+			for (int k = 0; k < 8; k++) {
+				l[k] = _mm_loadu_ps(z + static_cast<size_t>(k) * stride);
+				r[k] = _mm_loadu_ps(z + static_cast<size_t>(k) * stride + 4);
+				// Sums and sums of squares of the samples of each quarter
+				const int h = k < 4 ? 0 : 2;
+				__m128d a0 = _mm_cvtps_pd(l[k]);
+				__m128d a1 = _mm_cvtps_pd(_mm_movehl_ps(l[k], l[k]));
+				__m128d b0 = _mm_cvtps_pd(r[k]);
+				__m128d b1 = _mm_cvtps_pd(_mm_movehl_ps(r[k], r[k]));
+				s[h] = _mm_add_pd(s[h], _mm_add_pd(a0, a1));
+				q[h] = _mm_add_pd(q[h], _mm_add_pd(_mm_mul_pd(a0, a0), _mm_mul_pd(a1, a1)));
+				s[h+1] = _mm_add_pd(s[h+1], _mm_add_pd(b0, b1));
+				q[h+1] = _mm_add_pd(q[h+1], _mm_add_pd(_mm_mul_pd(b0, b0), _mm_mul_pd(b1, b1)));
+			}
+
+			// zdct = dct2(z); (columns, then rows)
+			dct8x128(l);
+			dct8x128(r);
+			transpose8x128(l, r);
+			dct8x128(l);
+			dct8x128(r);
+			transpose8x128(l, r);
+
+			// m = m + (zdct(k,l).^2) * mask(k,l);
+			__m128 m = _mm_setzero_ps();
+			for (int k = 0; k < 8; k++) {
+				l[k] = _mm_mul_ps(l[k], scale);
+				r[k] = _mm_mul_ps(r[k], scale);
+				_mm_storeu_ps(zdct + 8*k, l[k]);
+				_mm_storeu_ps(zdct + 8*k + 4, r[k]);
+				m = _mm_add_ps(m, _mm_mul_ps(_mm_mul_ps(l[k], l[k]), table[2*k]));
+				m = _mm_add_ps(m, _mm_mul_ps(_mm_mul_ps(r[k], r[k]), table[2*k+1]));
+			}
+			double sum[4], sq[4];
+			for (int i = 0; i < 4; i++) {
+				sum[i] = hsum128(s[i]);
+				sq[i] = hsum128(q[i]);
+			}
+			mask[j] = hvsMask(hsum128(m), sum, sq);
+		}
+	}
+
+	TARGET("sse4.2")
+	void hvsBlockSSE42(const float *a, const float *b, const float *csf, const float *mask_table,
+		float mask, double& s1, double& s2)
+	{
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const __m128 vmask = _mm_set1_ps(mask);
+		__m128 vs1 = _mm_setzero_ps();
+		__m128 vs2 = _mm_setzero_ps();
+		for (int i = 0; i < 64; i += 4) {
+			__m128 u = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			__m128 c = _mm_loadu_ps(csf + i);
+			__m128 tmp = _mm_mul_ps(u, c);
+			vs2 = _mm_add_ps(vs2, _mm_mul_ps(tmp, tmp));
+			__m128 th = _mm_div_ps(vmask, _mm_loadu_ps(mask_table + i));
+			if (i == 0) {
+				th = _mm_mul_ps(th, _mm_loadu_ps(HVS_DC));
+			}
+			u = _mm_andnot_ps(_mm_cmplt_ps(u, th), _mm_sub_ps(u, th));
+			tmp = _mm_mul_ps(u, c);
+			vs1 = _mm_add_ps(vs1, _mm_mul_ps(tmp, tmp));
+		}
+		s1 += static_cast<double>(hsum128(vs1));
+		s2 += static_cast<double>(hsum128(vs2));
+	}
+
+	TARGET("sse4.2")
+	__m128 log128(__m128 x)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		__m128i bits = _mm_castps_si128(x);
+		__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+		// m < sqrt(2)/2: 2m-1 and e-1
+		__m128 small = _mm_cmplt_ps(m, _mm_set1_ps(LOG_SQRTHF));
+		__m128 e = _mm_sub_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126))),
+			_mm_and_ps(small, one));
+		x = _mm_add_ps(_mm_sub_ps(m, one), _mm_and_ps(small, m));
+		__m128 z = _mm_mul_ps(x, x);
+		__m128 y = _mm_set1_ps(LOG_P[0]);
+		for (int k = 1; k < 9; k++) {
+			y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P[k]));
+		}
+		y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+		y = _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(LOG_Q1)), y);
+		y = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(-0.5f)), y);
+		return _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(LOG_Q2)), _mm_add_ps(x, y));
+	}
+
+	TARGET("sse4.2")
+	void vifLogSumsSSE42(const float *mu1, const float *mu2, const float *e11, const float *e22,
+		const float *e12, float sigma_nsq, int n, double& num, double& den)
+	{
+		__m128 vnum = _mm_setzero_ps();
+		__m128 vden = _mm_setzero_ps();
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 eps = _mm_set1_ps(VIF_EPSILON);
+		const __m128 nsq = _mm_set1_ps(sigma_nsq);
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128 m1 = _mm_loadu_ps(mu1 + i);
+			__m128 m2 = _mm_loadu_ps(mu2 + i);
+			__m128 s1 = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(e11 + i), _mm_mul_ps(m1, m1)), zero);
+			__m128 s2 = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(e22 + i), _mm_mul_ps(m2, m2)), zero);
+			__m128 s12 = _mm_sub_ps(_mm_loadu_ps(e12 + i), _mm_mul_ps(m1, m2));
+			__m128 g = _mm_div_ps(s12, _mm_add_ps(s1, eps));
+			__m128 sv = _mm_sub_ps(s2, _mm_mul_ps(g, s12));
+			__m128 th = _mm_cmpgt_ps(s1, eps);
+			g = _mm_and_ps(g, th);
+			sv = _mm_blendv_ps(s2, sv, th);
+			s1 = _mm_and_ps(s1, th);
+			th = _mm_cmpgt_ps(s2, eps);
+			g = _mm_and_ps(g, th);
+			sv = _mm_and_ps(sv, th);
+			th = _mm_cmpgt_ps(g, zero);
+			sv = _mm_blendv_ps(s2, sv, th);
+			g = _mm_and_ps(g, th);
+			sv = _mm_max_ps(sv, eps);
+			__m128 r = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(g, g), s1), _mm_add_ps(sv, nsq));
+			vnum = _mm_add_ps(vnum, log128(_mm_add_ps(one, r)));
+			vden = _mm_add_ps(vden, log128(_mm_add_ps(one, _mm_div_ps(s1, nsq))));
+		}
+		num += static_cast<double>(hsum128(vnum));
+		den += static_cast<double>(hsum128(vden));
+		vifLogSumsGeneric(mu1 + i, mu2 + i, e11 + i, e22 + i, e12 + i, sigma_nsq, n - i, num, den);
+	}
+
+	/*
+	 * AVX2 versions
+	 */
+
+	TARGET("avx2,fma")
+	float hsum256(__m256 v)
+	{
+		__m128 r = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+		r = _mm_add_ss(r, _mm_movehdup_ps(r));
+		return _mm_cvtss_f32(r);
+	}
+
+	TARGET("avx2,fma")
+	double sumSquaredDiffAVX2(const float *a, const float *b, int n)
+	{
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+			d = _mm256_mul_ps(d, d);
+			acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(d)));
+			acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)));
+		}
+		acc0 = _mm256_add_pd(acc0, acc1);
+		__m128d r = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+		r = _mm_add_sd(r, _mm_unpackhi_pd(r, r));
+		return _mm_cvtsd_f64(r) + sumSquaredDiffGeneric(a + i, b + i, n - i);
+	}
+
+	TARGET("avx2,fma")
+	uint64_t hsum256(__m256i v)
+	{
+		uint64_t lanes[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), v);
+		return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+
+	TARGET("avx2,fma")
+	uint64_t sumSquaredDiffU8AVX2(const unsigned char *a, const unsigned char *b, int n)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i acc = _mm256_setzero_si256();
+		int i = 0;
+		while (i + 32 <= n) {
+			const int end = std::min(n, i + 32 * U8_BLOCK);
+			__m256i sum = _mm256_setzero_si256();
+			for (; i + 32 <= end; i += 32) {
+				__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+				__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+				__m256i lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero));
+				__m256i hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero));
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(lo, lo));
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(hi, hi));
+			}
+			acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sum)));
+			acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sum, 1)));
+		}
+		return hsum256(acc) + sumSquaredDiffU8Generic(a + i, b + i, n - i);
+	}
+
+	TARGET("avx2,fma")
+	uint64_t sumSquaredDiffU16AVX2(const unsigned short *a, const unsigned short *b, int n)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i acc = _mm256_setzero_si256();
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			__m256i d = _mm256_or_si256(_mm256_subs_epu16(va, vb), _mm256_subs_epu16(vb, va));
+			__m256i lo = _mm256_unpacklo_epi16(d, zero);
+			__m256i hi = _mm256_unpackhi_epi16(d, zero);
+			acc = _mm256_add_epi64(acc, _mm256_mul_epu32(lo, lo));
+			acc = _mm256_add_epi64(acc, _mm256_mul_epu32(hi, hi));
+			lo = _mm256_srli_epi64(lo, 32);
+			hi = _mm256_srli_epi64(hi, 32);
+			acc = _mm256_add_epi64(acc, _mm256_mul_epu32(lo, lo));
+			acc = _mm256_add_epi64(acc, _mm256_mul_epu32(hi, hi));
+		}
+		return hsum256(acc) + sumSquaredDiffU16Generic(a + i, b + i, n - i);
+	}
+
+	TARGET("avx2,fma")
+	double hsum256(__m256d v)
+	{
+		__m128d x = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+	}
+
+	// dct8Generic() of the 8 vectors, lane by lane
+	TARGET("avx2,fma")
+	void dct8x256(__m256 *v)
+	{
+		__m256 tmp0 = _mm256_add_ps(v[0], v[7]);
+		__m256 tmp7 = _mm256_sub_ps(v[0], v[7]);
+		__m256 tmp1 = _mm256_add_ps(v[1], v[6]);
+		__m256 tmp6 = _mm256_sub_ps(v[1], v[6]);
+		__m256 tmp2 = _mm256_add_ps(v[2], v[5]);
+		__m256 tmp5 = _mm256_sub_ps(v[2], v[5]);
+		__m256 tmp3 = _mm256_add_ps(v[3], v[4]);
+		__m256 tmp4 = _mm256_sub_ps(v[3], v[4]);
+
+		// Even part
+		__m256 tmp10 = _mm256_add_ps(tmp0, tmp3);
+		__m256 tmp13 = _mm256_sub_ps(tmp0, tmp3);
+		__m256 tmp11 = _mm256_add_ps(tmp1, tmp2);
+		__m256 tmp12 = _mm256_sub_ps(tmp1, tmp2);
+		v[0] = _mm256_add_ps(tmp10, tmp11);
+		v[4] = _mm256_sub_ps(tmp10, tmp11);
+		__m256 z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), _mm256_set1_ps(DCT_0_541196100));
+		v[2] = _mm256_fmadd_ps(tmp13, _mm256_set1_ps(DCT_0_765366865), z1);
+		v[6] = _mm256_fnmadd_ps(tmp12, _mm256_set1_ps(DCT_1_847759065), z1);
+
+		// Odd part
+		z1 = _mm256_add_ps(tmp4, tmp7);
+		__m256 z2 = _mm256_add_ps(tmp5, tmp6);
+		__m256 z3 = _mm256_add_ps(tmp4, tmp6);
+		__m256 z4 = _mm256_add_ps(tmp5, tmp7);
+		__m256 z5 = _mm256_mul_ps(_mm256_add_ps(z3, z4), _mm256_set1_ps(DCT_1_175875602));
+		z3 = _mm256_fnmadd_ps(z3, _mm256_set1_ps(DCT_1_961570561), z5);
+		z4 = _mm256_fnmadd_ps(z4, _mm256_set1_ps(DCT_0_390180644), z5);
+		z1 = _mm256_mul_ps(z1, _mm256_set1_ps(DCT_0_899976223));
+		z2 = _mm256_mul_ps(z2, _mm256_set1_ps(DCT_2_562915448));
+		v[7] = _mm256_add_ps(_mm256_fmsub_ps(tmp4, _mm256_set1_ps(DCT_0_298631336), z1), z3);
+		v[5] = _mm256_add_ps(_mm256_fmsub_ps(tmp5, _mm256_set1_ps(DCT_2_053119869), z2), z4);
+		v[3] = _mm256_add_ps(_mm256_fmsub_ps(tmp6, _mm256_set1_ps(DCT_3_072711027), z2), z3);
+		v[1] = _mm256_add_ps(_mm256_fmsub_ps(tmp7, _mm256_set1_ps(DCT_1_501321110), z1), z4);
+	}
+
+	// Transpose the 8x8 block whose row k is v[k]
+	TARGET("avx2,fma")
+	void transpose8x256(__m256 *v)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+		__m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+		__m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+		__m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+		__m256 t4 = _mm256_unpacklo_ps(v[4], v[5]);
+		__m256 t5 = _mm256_unpackhi_ps(v[4], v[5]);
+		__m256 t6 = _mm256_unpacklo_ps(v[6], v[7]);
+		__m256 t7 = _mm256_unpackhi_ps(v[6], v[7]);
+		__m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+		v[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+		v[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+		v[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+		v[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+		v[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+		v[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+		v[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+		v[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+	}
+
+	TARGET("avx2,fma")
+	void hvsTransformAVX2(const float *src, size_t stride, int n, const float *mask_table,
+		float *dct, float *mask)
+	{
+		const __m256 scale = _mm256_set1_ps(DCT_SCALE);
+		// Rows of MASK(k,l), but the DC one
+		__m256 table[8];
+		for (int k = 0; k < 8; k++) {
+			table[k] = _mm256_loadu_ps(mask_table + 8*k);
+		}
+		table[0] = _mm256_mul_ps(table[0], _mm256_loadu_ps(HVS_DC));
+
+		for (int j = 0; j < n; j++) {
+			const float *z = src + 8 * static_cast<size_t>(j);
+			float *zdct = dct + 64 * static_cast<size_t>(j);
+			__m256 v[8];
+			__m256d s[4], q[4];
+			for (int i = 0; i < 4; i++) {
+				s[i] = q[i] = _mm256_setzero_pd();
+			}
+			for (int k = 0; k < 8; k++) {
+				v[k] = _mm256_loadu_ps(z + static_cast<size_t>(k) * stride);
+				// Sums and sums of squares of the samples of each quarter
+				const int h = k < 4 ? 0 : 2;
+				__m256d a = _mm256_cvtps_pd(_mm256_castps256_ps128(v[k]));
+				__m256d b = _mm256_cvtps_pd(_mm256_extractf128_ps(v[k], 1));
+				s[h] = _mm256_add_pd(s[h], a);
+				q[h] = _mm256_fmadd_pd(a, a, q[h]);
+				s[h+1] = _mm256_add_pd(s[h+1], b);
+				q[h+1] = _mm256_fmadd_pd(b, b, q[h+1]);
+			}
+
+			// zdct = dct2(z); (columns, then rows)
+			dct8x256(v);
+			transpose8x256(v);
+			dct8x256(v);
+			transpose8x256(v);
+
+			// m = m + (zdct(k,l).^2) * mask(k,l);
+			__m256 m = _mm256_setzero_ps();
+			for (int k = 0; k < 8; k++) {
+				v[k] = _mm256_mul_ps(v[k], scale);
+				_mm256_storeu_ps(zdct + 8*k, v[k]);
+				m = _mm256_fmadd_ps(_mm256_mul_ps(v[k], v[k]), table[k], m);
+			}
+			double sum[4], sq[4];
+			for (int i = 0; i < 4; i++) {
+				sum[i] = hsum256(s[i]);
+				sq[i] = hsum256(q[i]);
+			}
+			mask[j] = hvsMask(hsum256(m), sum, sq);
+		}
+	}
+
+	TARGET("avx2,fma")
+	void hvsBlockAVX2(const float *a, const float *b, const float *csf, const float *mask_table,
+		float mask, double& s1, double& s2)
+	{
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		const __m256 vmask = _mm256_set1_ps(mask);
+		__m256 vs1 = _mm256_setzero_ps();
+		__m256 vs2 = _mm256_setzero_ps();
+		for (int i = 0; i < 64; i += 8) {
+			__m256 u = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+			__m256 c = _mm256_loadu_ps(csf + i);
+			__m256 tmp = _mm256_mul_ps(u, c);
+			vs2 = _mm256_add_ps(vs2, _mm256_mul_ps(tmp, tmp));
+			__m256 th = _mm256_div_ps(vmask, _mm256_loadu_ps(mask_table + i));
+			if (i == 0) {
+				th = _mm256_mul_ps(th, _mm256_loadu_ps(HVS_DC));
+			}
+			u = _mm256_andnot_ps(_mm256_cmp_ps(u, th, _CMP_LT_OQ), _mm256_sub_ps(u, th));
+			tmp = _mm256_mul_ps(u, c);
+			vs1 = _mm256_add_ps(vs1, _mm256_mul_ps(tmp, tmp));
+		}
+		s1 += static_cast<double>(hsum256(vs1));
+		s2 += static_cast<double>(hsum256(vs2));
+	}
+
+	TARGET("avx2,fma")
+	__m256 log256(__m256 x)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		__m256i bits = _mm256_castps_si256(x);
+		__m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+		// m < sqrt(2)/2: 2m-1 and e-1
+		__m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+		__m256 e = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126))),
+			_mm256_and_ps(small, one));
+		x = _mm256_add_ps(_mm256_sub_ps(m, one), _mm256_and_ps(small, m));
+		__m256 z = _mm256_mul_ps(x, x);
+		__m256 y = _mm256_set1_ps(LOG_P[0]);
+		for (int k = 1; k < 9; k++) {
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P[k]));
+		}
+		y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+		y = _mm256_fmadd_ps(e, _mm256_set1_ps(LOG_Q1), y);
+		y = _mm256_fmadd_ps(z, _mm256_set1_ps(-0.5f), y);
+		return _mm256_fmadd_ps(e, _mm256_set1_ps(LOG_Q2), _mm256_add_ps(x, y));
+	}
+
+	TARGET("avx2,fma")
+	void vifLogSumsAVX2(const float *mu1, const float *mu2, const float *e11, const float *e22,
+		const float *e12, float sigma_nsq, int n, double& num, double& den)
+	{
+		__m256 vnum = _mm256_setzero_ps();
+		__m256 vden = _mm256_setzero_ps();
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 eps = _mm256_set1_ps(VIF_EPSILON);
+		const __m256 nsq = _mm256_set1_ps(sigma_nsq);
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 m1 = _mm256_loadu_ps(mu1 + i);
+			__m256 m2 = _mm256_loadu_ps(mu2 + i);
+			__m256 s1 = _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(e11 + i), _mm256_mul_ps(m1, m1)), zero);
+			__m256 s2 = _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(e22 + i), _mm256_mul_ps(m2, m2)), zero);
+			__m256 s12 = _mm256_sub_ps(_mm256_loadu_ps(e12 + i), _mm256_mul_ps(m1, m2));
+			__m256 g = _mm256_div_ps(s12, _mm256_add_ps(s1, eps));
+			__m256 sv = _mm256_sub_ps(s2, _mm256_mul_ps(g, s12));
+			__m256 th = _mm256_cmp_ps(s1, eps, _CMP_GT_OQ);
+			g = _mm256_and_ps(g, th);
+			sv = _mm256_blendv_ps(s2, sv, th);
+			s1 = _mm256_and_ps(s1, th);
+			th = _mm256_cmp_ps(s2, eps, _CMP_GT_OQ);
+			g = _mm256_and_ps(g, th);
+			sv = _mm256_and_ps(sv, th);
+			th = _mm256_cmp_ps(g, zero, _CMP_GT_OQ);
+			sv = _mm256_blendv_ps(s2, sv, th);
+			g = _mm256_and_ps(g, th);
+			sv = _mm256_max_ps(sv, eps);
+			__m256 r = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(g, g), s1), _mm256_add_ps(sv, nsq));
+			vnum = _mm256_add_ps(vnum, log256(_mm256_add_ps(one, r)));
+			vden = _mm256_add_ps(vden, log256(_mm256_add_ps(one, _mm256_div_ps(s1, nsq))));
+		}
+		num += static_cast<double>(hsum256(vnum));
+		den += static_cast<double>(hsum256(vden));
+		vifLogSumsGeneric(mu1 + i, mu2 + i, e11 + i, e22 + i, e12 + i, sigma_nsq, n - i, num, den);
+	}
+
+	/*
+	 * AVX-512 versions
+	 */
+
+	// GCC 12 implements the plain forms of many AVX-512 intrinsics (and the
+	// reductions, casts and extractions built on them) by passing
+	// _mm512_undefined_*() to the masked builtin, which -flto reports as
+	// used uninitialized. Their zero-masking forms under a full mask give
+	// the same instructions on defined values.
+	const __mmask8 ALL8 = 0xff;
+	const __mmask16 ALL16 = 0xffff;
+
+	// Low and high halves of a vector
+	TARGET("avx512f,avx512bw")
+	__m256i lo256(__m512i v)
+	{
+		return _mm512_maskz_extracti64x4_epi64(ALL8, v, 0);
+	}
+
+	TARGET("avx512f,avx512bw")
+	__m256i hi256(__m512i v)
+	{
+		return _mm512_maskz_extracti64x4_epi64(ALL8, v, 1);
+	}
+
+	TARGET("avx512f,avx512bw")
+	uint64_t hsum512(__m512i v)
+	{
+		return hsum256(_mm256_add_epi64(lo256(v), hi256(v)));
+	}
+
+	TARGET("avx512f,avx512bw")
+	__m256d lo256(__m512d v)
+	{
+		return _mm512_maskz_extractf64x4_pd(ALL8, v, 0);
+	}
+
+	TARGET("avx512f,avx512bw")
+	__m256d hi256(__m512d v)
+	{
+		return _mm512_maskz_extractf64x4_pd(ALL8, v, 1);
+	}
+
+	TARGET("avx512f,avx512bw")
+	__m256 lo256(__m512 v)
+	{
+		return _mm256_castpd_ps(lo256(_mm512_castps_pd(v)));
+	}
+
+	TARGET("avx512f,avx512bw")
+	__m256 hi256(__m512 v)
+	{
+		return _mm256_castpd_ps(hi256(_mm512_castps_pd(v)));
+	}
+
+	TARGET("avx512f,avx512bw")
+	float hsum512(__m512 v)
+	{
+		return hsum256(_mm256_add_ps(lo256(v), hi256(v)));
+	}
+
+	TARGET("avx512f,avx512bw")
+	double hsum512(__m512d v)
+	{
+		return hsum256(_mm256_add_pd(lo256(v), hi256(v)));
+	}
+
+	TARGET("avx512f,avx512bw")
+	double sumSquaredDiffAVX512(const float *a, const float *b, int n)
+	{
+		__m512d acc0 = _mm512_setzero_pd();
+		__m512d acc1 = _mm512_setzero_pd();
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+			__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+			acc0 = _mm512_add_pd(acc0, _mm512_maskz_cvtps_pd(ALL8, _mm256_mul_ps(d0, d0)));
+			acc1 = _mm512_add_pd(acc1, _mm512_maskz_cvtps_pd(ALL8, _mm256_mul_ps(d1, d1)));
+		}
+		return hsum512(_mm512_add_pd(acc0, acc1)) + sumSquaredDiffGeneric(a + i, b + i, n - i);
+	}
+
+	TARGET("avx512f,avx512bw")
+	uint64_t sumSquaredDiffU8AVX512(const unsigned char *a, const unsigned char *b, int n)
+	{
+		const __m512i zero = _mm512_setzero_si512();
+		__m512i acc = _mm512_setzero_si512();
+		int i = 0;
+		while (i + 64 <= n) {
+			const int end = std::min(n, i + 64 * U8_BLOCK);
+			__m512i sum = _mm512_setzero_si512();
+			for (; i + 64 <= end; i += 64) {
+				__m512i va = _mm512_loadu_si512(a + i);
+				__m512i vb = _mm512_loadu_si512(b + i);
+				__m512i lo = _mm512_sub_epi16(_mm512_unpacklo_epi8(va, zero), _mm512_unpacklo_epi8(vb, zero));
+				__m512i hi = _mm512_sub_epi16(_mm512_unpackhi_epi8(va, zero), _mm512_unpackhi_epi8(vb, zero));
+				sum = _mm512_add_epi32(sum, _mm512_madd_epi16(lo, lo));
+				sum = _mm512_add_epi32(sum, _mm512_madd_epi16(hi, hi));
+			}
+			acc = _mm512_add_epi64(acc, _mm512_maskz_cvtepu32_epi64(ALL8, lo256(sum)));
+			acc = _mm512_add_epi64(acc, _mm512_maskz_cvtepu32_epi64(ALL8, hi256(sum)));
+		}
+		return hsum512(acc) + sumSquaredDiffU8Generic(a + i, b + i, n - i);
+	}
+
+	TARGET("avx512f,avx512bw")
+	uint64_t sumSquaredDiffU16AVX512(const unsigned short *a, const unsigned short *b, int n)
+	{
+		const __m512i zero = _mm512_setzero_si512();
+		__m512i acc = _mm512_setzero_si512();
+		int i = 0;
+		for (; i + 32 <= n; i += 32) {
+			__m512i va = _mm512_loadu_si512(a + i);
+			__m512i vb = _mm512_loadu_si512(b + i);
+			__m512i d = _mm512_or_si512(_mm512_subs_epu16(va, vb), _mm512_subs_epu16(vb, va));
+			__m512i lo = _mm512_unpacklo_epi16(d, zero);
+			__m512i hi = _mm512_unpackhi_epi16(d, zero);
+			acc = _mm512_add_epi64(acc, _mm512_maskz_mul_epu32(ALL8, lo, lo));
+			acc = _mm512_add_epi64(acc, _mm512_maskz_mul_epu32(ALL8, hi, hi));
+			lo = _mm512_maskz_srli_epi64(ALL8, lo, 32);
+			hi = _mm512_maskz_srli_epi64(ALL8, hi, 32);
+			acc = _mm512_add_epi64(acc, _mm512_maskz_mul_epu32(ALL8, lo, lo));
+			acc = _mm512_add_epi64(acc, _mm512_maskz_mul_epu32(ALL8, hi, hi));
+		}
+		return hsum512(acc) + sumSquaredDiffU16Generic(a + i, b + i, n - i);
+	}
+
+	// dct8Generic() of the 8 vectors, lane by lane
+	TARGET("avx512f,avx512bw")
+	void dct8x512(__m512 *v)
+	{
+		__m512 tmp0 = _mm512_add_ps(v[0], v[7]);
+		__m512 tmp7 = _mm512_sub_ps(v[0], v[7]);
+		__m512 tmp1 = _mm512_add_ps(v[1], v[6]);
+		__m512 tmp6 = _mm512_sub_ps(v[1], v[6]);
+		__m512 tmp2 = _mm512_add_ps(v[2], v[5]);
+		__m512 tmp5 = _mm512_sub_ps(v[2], v[5]);
+		__m512 tmp3 = _mm512_add_ps(v[3], v[4]);
+		__m512 tmp4 = _mm512_sub_ps(v[3], v[4]);
+
+		// Even part
+		__m512 tmp10 = _mm512_add_ps(tmp0, tmp3);
+		__m512 tmp13 = _mm512_sub_ps(tmp0, tmp3);
+		__m512 tmp11 = _mm512_add_ps(tmp1, tmp2);
+		__m512 tmp12 = _mm512_sub_ps(tmp1, tmp2);
+		v[0] = _mm512_add_ps(tmp10, tmp11);
+		v[4] = _mm512_sub_ps(tmp10, tmp11);
+		__m512 z1 = _mm512_mul_ps(_mm512_add_ps(tmp12, tmp13), _mm512_set1_ps(DCT_0_541196100));
+		v[2] = _mm512_fmadd_ps(tmp13, _mm512_set1_ps(DCT_0_765366865), z1);
+		v[6] = _mm512_fnmadd_ps(tmp12, _mm512_set1_ps(DCT_1_847759065), z1);
+
+		// Odd part
+		z1 = _mm512_add_ps(tmp4, tmp7);
+		__m512 z2 = _mm512_add_ps(tmp5, tmp6);
+		__m512 z3 = _mm512_add_ps(tmp4, tmp6);
+		__m512 z4 = _mm512_add_ps(tmp5, tmp7);
+		__m512 z5 = _mm512_mul_ps(_mm512_add_ps(z3, z4), _mm512_set1_ps(DCT_1_175875602));
+		z3 = _mm512_fnmadd_ps(z3, _mm512_set1_ps(DCT_1_961570561), z5);
+		z4 = _mm512_fnmadd_ps(z4, _mm512_set1_ps(DCT_0_390180644), z5);
+		z1 = _mm512_mul_ps(z1, _mm512_set1_ps(DCT_0_899976223));
+		z2 = _mm512_mul_ps(z2, _mm512_set1_ps(DCT_2_562915448));
+		v[7] = _mm512_add_ps(_mm512_fmsub_ps(tmp4, _mm512_set1_ps(DCT_0_298631336), z1), z3);
+		v[5] = _mm512_add_ps(_mm512_fmsub_ps(tmp5, _mm512_set1_ps(DCT_2_053119869), z2), z4);
+		v[3] = _mm512_add_ps(_mm512_fmsub_ps(tmp6, _mm512_set1_ps(DCT_3_072711027), z2), z3);
+		v[1] = _mm512_add_ps(_mm512_fmsub_ps(tmp7, _mm512_set1_ps(DCT_1_501321110), z1), z4);
+	}
+
+	// Transpose the two 8x8 blocks whose row k is v[k], side by side
+	TARGET("avx512f,avx512bw")
+	void transpose8x512(__m512 *v)
+	{
+		// Lanes of each block gathered from the first and second halves of
+		// its columns
+		const __m512i lo = _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19, 8, 9, 10, 11, 24, 25, 26, 27);
+		const __m512i hi = _mm512_setr_epi32(4, 5, 6, 7, 20, 21, 22, 23, 12, 13, 14, 15, 28, 29, 30, 31);
+		__m512 t0 = _mm512_maskz_unpacklo_ps(ALL16, v[0], v[1]);
+		__m512 t1 = _mm512_maskz_unpackhi_ps(ALL16, v[0], v[1]);
+		__m512 t2 = _mm512_maskz_unpacklo_ps(ALL16, v[2], v[3]);
+		__m512 t3 = _mm512_maskz_unpackhi_ps(ALL16, v[2], v[3]);
+		__m512 t4 = _mm512_maskz_unpacklo_ps(ALL16, v[4], v[5]);
+		__m512 t5 = _mm512_maskz_unpackhi_ps(ALL16, v[4], v[5]);
+		__m512 t6 = _mm512_maskz_unpacklo_ps(ALL16, v[6], v[7]);
+		__m512 t7 = _mm512_maskz_unpackhi_ps(ALL16, v[6], v[7]);
+		__m512 u0 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m512 u1 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m512 u2 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m512 u3 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		__m512 u4 = _mm512_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		__m512 u5 = _mm512_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		__m512 u6 = _mm512_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		__m512 u7 = _mm512_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+		v[0] = _mm512_permutex2var_ps(u0, lo, u4);
+		v[1] = _mm512_permutex2var_ps(u1, lo, u5);
+		v[2] = _mm512_permutex2var_ps(u2, lo, u6);
+		v[3] = _mm512_permutex2var_ps(u3, lo, u7);
+		v[4] = _mm512_permutex2var_ps(u0, hi, u4);
+		v[5] = _mm512_permutex2var_ps(u1, hi, u5);
+		v[6] = _mm512_permutex2var_ps(u2, hi, u6);
+		v[7] = _mm512_permutex2var_ps(u3, hi, u7);
+	}
+
+	TARGET("avx512f,avx512bw")
+	void hvsTransformAVX512(const float *src, size_t stride, int n, const float *mask_table,
+		float *dct, float *mask)
+	{
+		const __m512 scale = _mm512_set1_ps(DCT_SCALE);
+		// Rows of MASK(k,l) of two blocks side by side, but the DC ones
+		__m512 table[8];
+		for (int k = 0; k < 8; k++) {
+			float row[16];
+			for (int l = 0; l < 8; l++) {
+				row[l] = row[l+8] = k == 0 ? mask_table[l] * HVS_DC[l] : mask_table[8*k + l];
+			}
+			table[k] = _mm512_loadu_ps(row);
+		}
+
+		// Two blocks at once, the last one of an odd count with AVX2
+		int j = 0;
+		for (; j + 2 <= n; j += 2) {
+			const float *z = src + 8 * static_cast<size_t>(j);
+			float *zdct = dct + 64 * static_cast<size_t>(j);
+			__m512 v[8];
+			// Sums and sums of squares of the top and bottom halves of each
+			// block, lanes 0-3 for its left quarters and 4-7 for its right ones
+			__m512d s[4], q[4];
+			for (int i = 0; i < 4; i++) {
+				s[i] = q[i] = _mm512_setzero_pd();
+			}
+			for (int k = 0; k < 8; k++) {
+				v[k] = _mm512_loadu_ps(z + static_cast<size_t>(k) * stride);
+				const int h = k < 4 ? 0 : 1;
+				__m512d a = _mm512_maskz_cvtps_pd(ALL8, lo256(v[k]));
+				__m512d b = _mm512_maskz_cvtps_pd(ALL8, hi256(v[k]));
+				s[h] = _mm512_add_pd(s[h], a);
+				q[h] = _mm512_fmadd_pd(a, a, q[h]);
+				s[h+2] = _mm512_add_pd(s[h+2], b);
+				q[h+2] = _mm512_fmadd_pd(b, b, q[h+2]);
+			}
+
+			// zdct = dct2(z); (columns, then rows)
+			dct8x512(v);
+			transpose8x512(v);
+			dct8x512(v);
+			transpose8x512(v);
+
+			// m = m + (zdct(k,l).^2) * mask(k,l);
+			__m512 m = _mm512_setzero_ps();
+			for (int k = 0; k < 8; k++) {
+				v[k] = _mm512_mul_ps(v[k], scale);
+				_mm256_storeu_ps(zdct + 8*k, lo256(v[k]));
+				_mm256_storeu_ps(zdct + 64 + 8*k, hi256(v[k]));
+				m = _mm512_fmadd_ps(_mm512_mul_ps(v[k], v[k]), table[k], m);
+			}
+			for (int b = 0; b < 2; b++) {
+				const __m512d *bs = s + 2*b;
+				const __m512d *bq = q + 2*b;
+				double sum[4] = {hsum256(lo256(bs[0])), hsum256(hi256(bs[0])), hsum256(lo256(bs[1])), hsum256(hi256(bs[1]))};
+				double sq[4] = {hsum256(lo256(bq[0])), hsum256(hi256(bq[0])), hsum256(lo256(bq[1])), hsum256(hi256(bq[1]))};
+				mask[j+b] = hvsMask(hsum256(b == 0 ? lo256(m) : hi256(m)), sum, sq);
+			}
+		}
+		if (j < n) {
+			hvsTransformAVX2(src + 8 * static_cast<size_t>(j), stride, n - j, mask_table,
+				dct + 64 * static_cast<size_t>(j), mask + j);
+		}
+	}
+
+	TARGET("avx512f,avx512bw")
+	void hvsBlockAVX512(const float *a, const float *b, const float *csf, const float *mask_table,
+		float mask, double& s1, double& s2)
+	{
+		const __m512 vmask = _mm512_set1_ps(mask);
+		__m512 vs1 = _mm512_setzero_ps();
+		__m512 vs2 = _mm512_setzero_ps();
+		for (int i = 0; i < 64; i += 16) {
+			__m512 u = _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+			__m512 c = _mm512_loadu_ps(csf + i);
+			__m512 tmp = _mm512_mul_ps(u, c);
+			vs2 = _mm512_add_ps(vs2, _mm512_mul_ps(tmp, tmp));
+			__m512 th = _mm512_div_ps(vmask, _mm512_loadu_ps(mask_table + i));
+			if (i == 0) {
+				th = _mm512_maskz_mov_ps(static_cast<__mmask16>(0xfffe), th);
+			}
+			__mmask16 keep = _mm512_cmp_ps_mask(u, th, _CMP_NLT_UQ);
+			u = _mm512_maskz_sub_ps(keep, u, th);
+			tmp = _mm512_mul_ps(u, c);
+			vs1 = _mm512_add_ps(vs1, _mm512_mul_ps(tmp, tmp));
+		}
+		s1 += static_cast<double>(hsum512(vs1));
+		s2 += static_cast<double>(hsum512(vs2));
+	}
+
+	TARGET("avx512f,avx512bw")
+	__m512 log512(__m512 x)
+	{
+		const __m512 one = _mm512_set1_ps(1.0f);
+		__m512i bits = _mm512_castps_si512(x);
+		__m512 m = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)), _mm512_set1_epi32(0x3f000000)));
+		// m < sqrt(2)/2: 2m-1 and e-1
+		__mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+		__m512 e = _mm512_maskz_cvtepi32_ps(ALL16, _mm512_sub_epi32(_mm512_maskz_srli_epi32(ALL16, bits, 23), _mm512_set1_epi32(126)));
+		e = _mm512_mask_sub_ps(e, small, e, one);
+		x = _mm512_sub_ps(m, one);
+		x = _mm512_mask_add_ps(x, small, x, m);
+		__m512 z = _mm512_mul_ps(x, x);
+		__m512 y = _mm512_set1_ps(LOG_P[0]);
+		for (int k = 1; k < 9; k++) {
+			y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(LOG_P[k]));
+		}
+		y = _mm512_mul_ps(_mm512_mul_ps(y, x), z);
+		y = _mm512_fmadd_ps(e, _mm512_set1_ps(LOG_Q1), y);
+		y = _mm512_fmadd_ps(z, _mm512_set1_ps(-0.5f), y);
+		return _mm512_fmadd_ps(e, _mm512_set1_ps(LOG_Q2), _mm512_add_ps(x, y));
+	}
+
+	TARGET("avx512f,avx512bw")
+	void vifLogSumsAVX512(const float *mu1, const float *mu2, const float *e11, const float *e22,
+		const float *e12, float sigma_nsq, int n, double& num, double& den)
+	{
+		__m512 vnum = _mm512_setzero_ps();
+		__m512 vden = _mm512_setzero_ps();
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512 one = _mm512_set1_ps(1.0f);
+		const __m512 eps = _mm512_set1_ps(VIF_EPSILON);
+		const __m512 nsq = _mm512_set1_ps(sigma_nsq);
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m512 m1 = _mm512_loadu_ps(mu1 + i);
+			__m512 m2 = _mm512_loadu_ps(mu2 + i);
+			__m512 s1 = _mm512_maskz_max_ps(ALL16, _mm512_sub_ps(_mm512_loadu_ps(e11 + i), _mm512_mul_ps(m1, m1)), zero);
+			__m512 s2 = _mm512_maskz_max_ps(ALL16, _mm512_sub_ps(_mm512_loadu_ps(e22 + i), _mm512_mul_ps(m2, m2)), zero);
+			__m512 s12 = _mm512_sub_ps(_mm512_loadu_ps(e12 + i), _mm512_mul_ps(m1, m2));
+			__m512 g = _mm512_div_ps(s12, _mm512_add_ps(s1, eps));
+			__m512 sv = _mm512_sub_ps(s2, _mm512_mul_ps(g, s12));
+			__mmask16 th = _mm512_cmp_ps_mask(s1, eps, _CMP_GT_OQ);
+			g = _mm512_maskz_mov_ps(th, g);
+			sv = _mm512_mask_blend_ps(th, s2, sv);
+			s1 = _mm512_maskz_mov_ps(th, s1);
+			th = _mm512_cmp_ps_mask(s2, eps, _CMP_GT_OQ);
+			g = _mm512_maskz_mov_ps(th, g);
+			sv = _mm512_maskz_mov_ps(th, sv);
+			th = _mm512_cmp_ps_mask(g, zero, _CMP_GT_OQ);
+			sv = _mm512_mask_blend_ps(th, s2, sv);
+			g = _mm512_maskz_mov_ps(th, g);
+			sv = _mm512_maskz_max_ps(ALL16, sv, eps);
+			__m512 r = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(g, g), s1), _mm512_add_ps(sv, nsq));
+			vnum = _mm512_add_ps(vnum, log512(_mm512_add_ps(one, r)));
+			vden = _mm512_add_ps(vden, log512(_mm512_add_ps(one, _mm512_div_ps(s1, nsq))));
+		}
+		num += static_cast<double>(hsum512(vnum));
+		den += static_cast<double>(hsum512(vden));
+		vifLogSumsGeneric(mu1 + i, mu2 + i, e11 + i, e22 + i, e12 + i, sigma_nsq, n - i, num, den);
+	}
+#endif
+
+	// Kernels of one instruction set
+	struct Table {
+		double (*sumSquaredDiff)(const float *, const float *, int);
+		uint64_t (*sumSquaredDiffU8)(const unsigned char *, const unsigned char *, int);
+		uint64_t (*sumSquaredDiffU16)(const unsigned short *, const unsigned short *, int);
+		void (*hvsTransform)(const float *, size_t, int, const float *, float *, float *);
+		void (*hvsBlock)(const float *, const float *, const float *, const float *, float, double&, double&);
+		void (*vifLogSums)(const float *, const float *, const float *, const float *, const float *,
+			float, int, double&, double&);
+	};
+
+	const Table TABLES[Kernels::LEVEL_SIZE] = {
+		{sumSquaredDiffGeneric, sumSquaredDiffU8Generic, sumSquaredDiffU16Generic, hvsTransformGeneric, hvsBlockGeneric, vifLogSumsGeneric},
+#if HAVE_X86_KERNELS
+		{sumSquaredDiffSSE42, sumSquaredDiffU8SSE42, sumSquaredDiffU16SSE42, hvsTransformSSE42, hvsBlockSSE42, vifLogSumsSSE42},
+		{sumSquaredDiffAVX2, sumSquaredDiffU8AVX2, sumSquaredDiffU16AVX2, hvsTransformAVX2, hvsBlockAVX2, vifLogSumsAVX2},
+		{sumSquaredDiffAVX512, sumSquaredDiffU8AVX512, sumSquaredDiffU16AVX512, hvsTransformAVX512, hvsBlockAVX512, vifLogSumsAVX512},
+#else
+		{sumSquaredDiffGeneric, sumSquaredDiffU8Generic, sumSquaredDiffU16Generic, hvsTransformGeneric, hvsBlockGeneric, vifLogSumsGeneric},
+		{sumSquaredDiffGeneric, sumSquaredDiffU8Generic, sumSquaredDiffU16Generic, hvsTransformGeneric, hvsBlockGeneric, vifLogSumsGeneric},
+		{sumSquaredDiffGeneric, sumSquaredDiffU8Generic, sumSquaredDiffU16Generic, hvsTransformGeneric, hvsBlockGeneric, vifLogSumsGeneric},
+#endif
+	};
+
+	const char *const NAMES[Kernels::LEVEL_SIZE] = {"generic", "sse4.2", "avx2", "avx512"};
+
+	Kernels::Level current = Kernels::detect();
+}
+
+Kernels::Level Kernels::detect()
+{
+#if HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+		return LEVEL_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return LEVEL_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		return LEVEL_SSE42;
+	}
+#endif
+	return LEVEL_GENERIC;
+}
+
+bool Kernels::select(Level level)
+{
+	if (level > detect()) {
+		return false;
+	}
+	current = level;
+	return true;
+}
+
+Kernels::Level Kernels::selected()
+{
+	return current;
+}
+
+const char *Kernels::name(Level level)
+{
+	return NAMES[level];
+}
+
+bool Kernels::parse(const char *str, Level& level)
+{
+	for (int l = 0; l < LEVEL_SIZE; l++) {
+		if (strcmp(str, NAMES[l]) == 0) {
+			level = static_cast<Level>(l);
+			return true;
+		}
+	}
+	return false;
+}
+
+double Kernels::sumSquaredDiff(const float *a, const float *b, int n)
+{
+	return TABLES[current].sumSquaredDiff(a, b, n);
+}
+
+uint64_t Kernels::sumSquaredDiff(const unsigned char *a, const unsigned char *b, int n)
+{
+	return TABLES[current].sumSquaredDiffU8(a, b, n);
+}
+
+uint64_t Kernels::sumSquaredDiff(const unsigned short *a, const unsigned short *b, int n)
+{
+	return TABLES[current].sumSquaredDiffU16(a, b, n);
+}
+
+void Kernels::hvsTransform(const float *src, size_t stride, int n, const float *mask_table,
+	float *dct, float *mask)
+{
+	TABLES[current].hvsTransform(src, stride, n, mask_table, dct, mask);
+}
+
+void Kernels::hvsBlock(const float *a_dct, const float *b_dct, const float *csf, const float *mask_table,
+	float mask, double& s1, double& s2)
+{
+	TABLES[current].hvsBlock(a_dct, b_dct, csf, mask_table, mask, s1, s2);
+}
+
+void Kernels::vifLogSums(const float *mu1, const float *mu2, const float *e11, const float *e22,
+	const float *e12, float sigma_nsq, int n, double& num, double& den)
+{
+	TABLES[current].vifLogSums(mu1, mu2, e11, e22, e12, sigma_nsq, n, num, den);
+}
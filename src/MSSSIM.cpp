@@ -37,61 +37,98 @@
 
 const double MSSSIM::WEIGHT[] = {0.0448, 0.2856, 0.3001, 0.2363, 0.1333};
 
-MSSSIM::MSSSIM(int h, int w) : SSIM(h, w, CV_32F)
+struct MSSSIM::State : Workspace::State {
+	double ssim = 0.0;
+	double msssim = 0.0;
+	// The first level refers to the input images
+	cv::Mat im1[NLEVS];
+	cv::Mat im2[NLEVS];
+	// Filtered x and x^2 of each level of the original image
+	cv::Mat ref_mu[NLEVS];
+	cv::Mat ref_sq[NLEVS];
+	// Line buffers of the pyramids
+	LineBuffers lines;
+};
+
+MSSSIM::MSSSIM(int h, int w, int bitdepth) : SSIM(h, w, CV_32F, bitdepth)
 {
-	for (int l=0; l<NLEVS; l++) {
-		im1[l] = cv::Mat(h,w,CV_32F);
-		im2[l] = cv::Mat(h,w,CV_32F);
-		w /= 2;
-		h /= 2;
-	}
 }
 
-float MSSSIM::compute(const cv::Mat& original, const cv::Mat& processed)
+float MSSSIM::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const
 {
-	double mssim[NLEVS];
-	double mcs[NLEVS];
+	setReference(original, ws);
+	return compute(processed, ws);
+}
+
+void MSSSIM::setReference(const cv::Mat& original, Workspace& ws) const
+{
+	State& st = ws.state<State>(this);
+	cv::Mat *im1 = st.im1;
+
+	// The first level is the original image itself, its moments are the
+	// same as those of SSIM
+	im1[0] = original;
 
-	int w = original.cols;
-	int h = original.rows;
-	
-	original.copyTo(im1[0]);
-	processed.copyTo(im2[0]);
-	
 	for (int l=0; l<NLEVS; l++) {
-		// [mssim_array(l) ssim_map_array{l} mcs_array(l) cs_map_array{l}] = ssim_index_new(im1, im2, K, window);
-		cv::Scalar res = SSIM::computeSSIM(im1[l], im2[l]);
-		mssim[l] = res.val[0];
-		mcs[l] = res.val[1];
+		if (l == 0) {
+			referenceMoments(im1[l], st.ref_mu[l], st.ref_sq[l], ws);
+		}
+		else {
+			filterReference(im1[l], st.ref_mu[l], st.ref_sq[l], ws);
+		}
 
 		if (l < NLEVS-1) {
-			w /= 2;
-			h /= 2;
-
 			// filtered_im1 = filter2(downsample_filter, im1, 'valid');
 			// im1 = filtered_im1(1:2:M-1, 1:2:N-1);
-			cv::resize(im1[l], im1[l+1], cv::Size(w,h), 0, 0, cv::INTER_LINEAR);
-			// filtered_im2 = filter2(downsample_filter, im2, 'valid');
-			// im2 = filtered_im2(1:2:M-1, 1:2:N-1);
-			cv::resize(im2[l], im2[l+1], cv::Size(w,h), 0, 0, cv::INTER_LINEAR);
+			// (mean of each 2x2 block, which only the kept samples compute)
+			applyAverageDecimate(im1[l], im1[l+1], st.lines);
 		}
 	}
+}
+
+float MSSSIM::compute(const cv::Mat& processed, Workspace& ws) const
+{
+	State& st = ws.state<State>(this);
+	const cv::Mat *im1 = st.im1;
+	cv::Mat *im2 = st.im2;
+	double mssim[NLEVS];
+	double mcs[NLEVS];
+
+	im2[0] = processed;
+
+	// [mssim_array(l) ssim_map_array{l} mcs_array(l) cs_map_array{l}] = ssim_index_new(im1, im2, K, window);
+	// Only mcs_array(1:level-1) and mssim_array(level) are used, plus
+	// mssim_array(1) for getSSIM(), so each level computes only these.
+	// The first level is computed alone, then the coarser ones, whose
+	// images are small enough to stay in the cache from their decimation,
+	// are computed together.
+	const int first_terms = SSIM_MEAN | CS_MEAN;
+	computeMeans(1, im1, im2, &first_terms, ws, mssim, mcs, st.ref_mu, st.ref_sq);
+
+	int terms[NLEVS];
+	for (int l=1; l<NLEVS; l++) {
+		// filtered_im2 = filter2(downsample_filter, im2, 'valid');
+		// im2 = filtered_im2(1:2:M-1, 1:2:N-1);
+		applyAverageDecimate(im2[l-1], im2[l], st.lines);
+		terms[l] = l < NLEVS-1 ? CS_MEAN : SSIM_MEAN;
+	}
+	computeMeans(NLEVS-1, im1 + 1, im2 + 1, terms + 1, ws, mssim + 1, mcs + 1, st.ref_mu + 1, st.ref_sq + 1);
 
-	ssim = mssim[0];
+	st.ssim = mssim[0];
 
 	// overall_mssim = prod(mcs_array(1:level-1).^weight(1:level-1))*mssim_array(level);
-	msssim = mssim[NLEVS-1];
-	for (int l=0; l<NLEVS-1; l++)	msssim *= pow(mcs[l], WEIGHT[l]);
+	st.msssim = mssim[NLEVS-1];
+	for (int l=0; l<NLEVS-1; l++)	st.msssim *= pow(mcs[l], WEIGHT[l]);
 
-	return float(msssim);
+	return float(st.msssim);
 }
 
-float MSSSIM::getSSIM()
+float MSSSIM::getSSIM(Workspace& ws) const
 {
-	return float(ssim);
+	return float(ws.state<State>(this).ssim);
 }
 
-float MSSSIM::getMSSSIM()
+float MSSSIM::getMSSSIM(Workspace& ws) const
 {
-	return float(msssim);
+	return float(ws.state<State>(this).msssim);
 }
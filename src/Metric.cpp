@@ -22,9 +22,11 @@
 // maintenance, support, updates, enhancements, or modifications.
 //
 
+#include <algorithm>
 #include "Metric.hpp"
 
-Metric::Metric(int h, int w, int t) : height(h), width(w), gb_tmp(h, w, t)
+Metric::Metric(int h, int w, int /* type */, int bitdepth) : height(h), width(w),
+	peak(static_cast<float>((1 << bitdepth) - 1)), range_sq((peak / 255.0f) * (peak / 255.0f))
 {
 }
 
@@ -33,16 +35,167 @@ Metric::~Metric()
 
 }
 
-void Metric::applyGaussianBlur(const cv::Mat& src, cv::Mat& dst, int ksize, double sigma)
+void Metric::runBands(const Workspace& ws, int nbands, const std::function<void(int, int)>& task)
 {
-	int invalid = (ksize-1)/2;
-	cv::GaussianBlur(src, gb_tmp, cv::Size(ksize,ksize), sigma);
-	gb_tmp(cv::Range(invalid, gb_tmp.rows-invalid), cv::Range(invalid, gb_tmp.cols - invalid)).copyTo(dst);
+	ThreadPool *pool = ws.getThreadPool();
+	if (pool == nullptr) {
+		for (int band = 0; band < nbands; band++) {
+			task(0, band);
+		}
+		return;
+	}
+	pool->parallelFor(nbands, task);
 }
 
-void Metric::applyBlur(const cv::Mat& src, cv::Mat& dst, int ksize)
+int Metric::workerCount(const Workspace& ws)
 {
-	cv::blur(src, gb_tmp, cv::Size(ksize, ksize), cv::Point(0, 0));
-	int invalid = ksize - 1;
-	gb_tmp(cv::Range(0, gb_tmp.rows - invalid), cv::Range(0, gb_tmp.cols - invalid)).copyTo(dst);
+	ThreadPool *pool = ws.getThreadPool();
+	return pool == nullptr ? 1 : pool->size();
+}
+
+void Metric::reserveLines(LineBuffers& buf, int nsrc, int cols, int cn, int ksize)
+{
+	const size_t line = static_cast<size_t>(std::min(cols - (ksize - 1), static_cast<int>(FILTER_TILE)) * cn);
+	buf.ring.reserve(static_cast<size_t>(nsrc * ksize) * line);
+	buf.out.reserve(static_cast<size_t>(nsrc) * line);
+	buf.rows.reserve(static_cast<size_t>(nsrc));
+}
+
+void Metric::runFilter(const cv::Mat *src, int nsrc, const float *k, int ksize, int y0, int y1,
+	LineBuffers& buf, const RowConsumer& emit)
+{
+	const int cn = src[0].channels();
+	const int out_cols = src[0].cols - (ksize - 1);
+	// Length of one line of the ring and of the output, in floats
+	const size_t line = static_cast<size_t>(std::min(out_cols, static_cast<int>(FILTER_TILE)) * cn);
+	const size_t ring_size = static_cast<size_t>(ksize) * line;
+
+	buf.ring.resize(static_cast<size_t>(nsrc) * ring_size);
+	buf.out.resize(static_cast<size_t>(nsrc) * line);
+	buf.rows.resize(static_cast<size_t>(nsrc));
+
+	for (int x0 = 0; x0 < out_cols; x0 += FILTER_TILE) {
+		const int n = std::min(static_cast<int>(FILTER_TILE), out_cols - x0);
+		const int len = n * cn;
+
+		// Horizontal filtering of the input row r into its line of the ring
+		auto filter_row = [&](int r) {
+			for (int s = 0; s < nsrc; s++) {
+				const float *p = src[s].ptr<float>(r) + x0 * cn;
+				float *h = &buf.ring[static_cast<size_t>(s) * ring_size + static_cast<size_t>(r % ksize) * line];
+				for (int i = 0; i < len; i++) {
+					h[i] = 0.0f;
+				}
+				for (int j = 0; j < ksize; j++) {
+					const float kj = k[j];
+					const float *pj = p + j * cn;
+					for (int i = 0; i < len; i++) {
+						h[i] += kj * pj[i];
+					}
+				}
+			}
+		};
+
+		for (int r = y0; r < y0 + ksize - 1; r++) {
+			filter_row(r);
+		}
+		for (int y = y0; y < y1; y++) {
+			filter_row(y + ksize - 1);
+
+			// Vertical filtering of the ksize lines of the ring
+			for (int s = 0; s < nsrc; s++) {
+				const float *ring = &buf.ring[static_cast<size_t>(s) * ring_size];
+				float *out = &buf.out[static_cast<size_t>(s) * line];
+				for (int i = 0; i < len; i++) {
+					out[i] = 0.0f;
+				}
+				for (int j = 0; j < ksize; j++) {
+					const float kj = k[j];
+					const float *h = ring + static_cast<size_t>((y + j) % ksize) * line;
+					for (int i = 0; i < len; i++) {
+						out[i] += kj * h[i];
+					}
+				}
+				buf.rows[static_cast<size_t>(s)] = out;
+			}
+			emit(y, x0, n, buf.rows.data());
+		}
+	}
+}
+
+void Metric::filterImage(const cv::Mat& src, cv::Mat& dst, const float *k, int ksize, LineBuffers& buf)
+{
+	const int cn = src.channels();
+	dst.create(src.rows - (ksize - 1), src.cols - (ksize - 1), src.type());
+	filterRows(&src, 1, k, ksize, 0, dst.rows, buf, [&](int y, int x0, int n, const float* const* rows) {
+		std::copy(rows[0], rows[0] + n * cn, dst.ptr<float>(y) + x0 * cn);
+	});
+}
+
+void Metric::applyGaussianBlur(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kernel, LineBuffers& buf)
+{
+	filterImage(src, dst, kernel.ptr<float>(0), kernel.rows, buf);
+}
+
+void Metric::applyBlur(const cv::Mat& src, cv::Mat& dst, int ksize, LineBuffers& buf)
+{
+	// Mean over the ksize x ksize window whose top-left corner is the pixel
+	// The kernel is kept in the buffers, so that it is not allocated again
+	buf.box.assign(static_cast<size_t>(ksize), 1.0f / static_cast<float>(ksize));
+	filterImage(src, dst, buf.box.data(), ksize, buf);
+}
+
+void Metric::decimateImage(const cv::Mat& src, cv::Mat& dst, const float *k, int ksize, LineBuffers& buf)
+{
+	// Output row y is the filtered input rows [2y, 2y+ksize), and each
+	// input row is filtered horizontally at the even columns only
+	const int rows = (src.rows - (ksize - 1) + 1) / 2;
+	const int cols = (src.cols - (ksize - 1) + 1) / 2;
+	const size_t line = static_cast<size_t>(cols);
+	dst.create(rows, cols, CV_32F);
+	buf.ring.resize(static_cast<size_t>(ksize) * line);
+
+	auto filter_row = [&](int r) {
+		const float *p = src.ptr<float>(r);
+		float *h = &buf.ring[static_cast<size_t>(r % ksize) * line];
+		for (int x = 0; x < cols; x++) {
+			const float *px = p + 2 * x;
+			float sum = 0.0f;
+			for (int j = 0; j < ksize; j++) {
+				sum += k[j] * px[j];
+			}
+			h[x] = sum;
+		}
+	};
+
+	for (int r = 0; r < ksize - 2; r++) {
+		filter_row(r);
+	}
+	for (int y = 0; y < rows; y++) {
+		filter_row(2 * y + ksize - 2);
+		filter_row(2 * y + ksize - 1);
+
+		float *out = dst.ptr<float>(y);
+		for (int x = 0; x < cols; x++) {
+			out[x] = 0.0f;
+		}
+		for (int j = 0; j < ksize; j++) {
+			const float kj = k[j];
+			const float *h = &buf.ring[static_cast<size_t>((2 * y + j) % ksize) * line];
+			for (int x = 0; x < cols; x++) {
+				out[x] += kj * h[x];
+			}
+		}
+	}
+}
+
+void Metric::applyGaussianDecimate(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kernel, LineBuffers& buf)
+{
+	decimateImage(src, dst, kernel.ptr<float>(0), kernel.rows, buf);
+}
+
+void Metric::applyAverageDecimate(const cv::Mat& src, cv::Mat& dst, LineBuffers& buf)
+{
+	static const float KERNEL[2] = {0.5f, 0.5f};
+	decimateImage(src, dst, KERNEL, 2, buf);
 }
@@ -0,0 +1,500 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <inttypes.h>
+#include <memory>
+#include "MetricRegistry.hpp"
+#include "PSNR.hpp"
+#include "SSIM.hpp"
+#include "MSSSIM.hpp"
+#include "VIFP.hpp"
+#include "PSNRHVS.hpp"
+#include "EWPSNR.hpp"
+#include "WSPSNR.hpp"
+
+typedef MetricRegistry::Provider Provider;
+typedef MetricRegistry::Declaration Declaration;
+
+namespace {
+	// Name of each metric on the command line and suffix of its output file
+	const char *const METRIC_NAMES[METRIC_SIZE][2] = {
+		{"PSNR", "psnr"}, {"YUVPSNR", "yuvpsnr"}, {"SSIM", "ssim"}, {"YUVSSIM", "yuvssim"},
+		{"MSSSIM", "msssim"}, {"VIFP", "vifp"}, {"PSNRHVS", "psnrhvs"}, {"PSNRHVSM", "psnrhvsm"},
+		{"EWPSNR", "ewpsnr"}, {"WSPSNR", "wspsnr"}, {"YUVWSPSNR", "yuvwspsnr"}
+	};
+
+	bool isYUV(int metric)
+	{
+		return metric == METRIC_YUVPSNR || metric == METRIC_YUVSSIM || metric == METRIC_YUVWSPSNR;
+	}
+
+	// Metric computed from each pair of original and processed luma images
+	template <class T> class PairProvider : public Provider {
+	public:
+		explicit PairProvider(T *m) : metric(m) {}
+		void compute(const FrameSet& set, int /* frame */, Workspace& ws, float *values) const
+		{
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				columns(values, 1, i, 0)[0] = metric->compute(set.original, set.processed[i], ws);
+			}
+		}
+	private:
+		std::unique_ptr<T> metric;
+	};
+
+	// Metric whose terms which only depend on the original image are
+	// computed once for all the processed images
+	template <class T> class ReferenceProvider : public Provider {
+	public:
+		explicit ReferenceProvider(T *m) : metric(m) {}
+		void compute(const FrameSet& set, int /* frame */, Workspace& ws, float *values) const
+		{
+			metric->setReference(set.original, ws);
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				columns(values, 1, i, 0)[0] = metric->compute(set.processed[i], ws);
+			}
+		}
+	private:
+		std::unique_ptr<T> metric;
+	};
+
+	// PSNR and YUV-PSNR, computed with integers on the planes of samples:
+	// the PSNR of the luma, or the PSNR of the weighted mean squared errors
+	// of the planes, then of each plane
+	// The squared errors of each processed image are also summed over the
+	// frames computed with each workspace, for the PSNR of the sequence.
+	class PSNRProvider : public Provider {
+	public:
+		PSNRProvider(PSNR *m, int n, const double *w) : metric(m), nbplanes(n)
+		{
+			std::copy(w, w + 3, weights);
+		}
+		void compute(const FrameSet& set, int /* frame */, Workspace& ws, float *values) const
+		{
+			Totals& totals = ws.state<Totals>(this);
+			totals.errors.resize(set.processed.size());
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				PSNR::SquaredErrors errors = PSNR::squaredErrors(set.original_planes, set.planes(i), nbplanes);
+				totals.errors[i] += errors;
+				float *v = columns(values, 1, i, 0);
+				v[0] = nbplanes == 1 ? metric->compute(errors) : metric->compute(errors, weights, v + 1);
+			}
+		}
+		void summary(const std::vector<Workspace>& workspaces, size_t i, int /* k */, FILE *file) const
+		{
+			PSNR::SquaredErrors errors;
+			for (size_t w = 0; w < workspaces.size(); w++) {
+				const Totals *totals = workspaces[w].find<Totals>(this);
+				if (totals != nullptr && i < totals->errors.size()) {
+					errors += totals->errors[i];
+				}
+			}
+			if (errors.samples[0] == 0) {
+				return;
+			}
+
+			if (nbplanes == 1) {
+				fprintf(file, "global,%.6f\n", static_cast<double>(metric->compute(errors)));
+				fprintf(file, "squared errors,%" PRIu64 "\n", errors.sse[0]);
+				fprintf(file, "samples,%" PRIu64 "\n", errors.samples[0]);
+				return;
+			}
+			float planes[3];
+			float value = metric->compute(errors, weights, planes);
+			fprintf(file, "global,%.6f,%.6f,%.6f,%.6f\n", static_cast<double>(value),
+				static_cast<double>(planes[0]), static_cast<double>(planes[1]), static_cast<double>(planes[2]));
+			fprintf(file, "squared errors,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+				errors.sse[0] + errors.sse[1] + errors.sse[2], errors.sse[0], errors.sse[1], errors.sse[2]);
+			fprintf(file, "samples,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+				errors.samples[0] + errors.samples[1] + errors.samples[2],
+				errors.samples[0], errors.samples[1], errors.samples[2]);
+		}
+	private:
+		struct Totals : Workspace::State {
+			std::vector<PSNR::SquaredErrors> errors;
+		};
+
+		std::unique_ptr<PSNR> metric;
+		int nbplanes;
+		double weights[3];
+	};
+
+	// WS-PSNR and YUV-WS-PSNR, computed on the planes of samples with the
+	// squared errors of each row summed with integers, then weighted by the
+	// row weights: the WS-PSNR of the luma, or the WS-PSNR of the weighted
+	// mean squared errors of the planes, then of each plane
+	class WSPSNRProvider : public Provider {
+	public:
+		WSPSNRProvider(WSPSNR *m, int n, const double *w) : metric(m), nbplanes(n)
+		{
+			std::copy(w, w + 3, weights);
+		}
+		void compute(const FrameSet& set, int /* frame */, Workspace& /* ws */, float *values) const
+		{
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				const cv::Mat *planes = set.planes(i);
+				float *v = columns(values, 1, i, 0);
+				v[0] = nbplanes == 1 ? metric->compute(set.original_planes[0], planes[0])
+					: metric->compute(set.original_planes, planes, weights, v + 1);
+			}
+		}
+	private:
+		std::unique_ptr<WSPSNR> metric;
+		int nbplanes;
+		double weights[3];
+	};
+
+	// YUV-SSIM, computed on each plane at its own size: the weighted mean of
+	// the SSIM of the planes, then the SSIM of each plane
+	// Each plane has its own metric, so that the three references are kept
+	// for all the processed images. The planes of a 4:0:0 video are left
+	// out, their SSIM is 0.
+	class YUVSSIMProvider : public Provider {
+	public:
+		YUVSSIMProvider(SSIM *y, SSIM *u, SSIM *v, const double *w)
+		{
+			metrics[0].reset(y);
+			metrics[1].reset(u);
+			metrics[2].reset(v);
+			std::copy(w, w + 3, weights);
+		}
+		void compute(const FrameSet& set, int /* frame */, Workspace& ws, float *values) const
+		{
+			const cv::Mat *original[3] = {&set.original, &set.original_chroma[0], &set.original_chroma[1]};
+			for (int c = 0; c < 3; c++) {
+				if (!original[c]->empty()) {
+					metrics[c]->setReference(*original[c], ws);
+				}
+			}
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				const cv::Mat *processed[3] = {&set.processed[i], &set.processed_chroma[2 * i], &set.processed_chroma[2 * i + 1]};
+				float *v = columns(values, 1, i, 0);
+				double sum = 0.0, sum_weights = 0.0;
+				for (int c = 0; c < 3; c++) {
+					v[1 + c] = 0.0f;
+					if (original[c]->empty()) {
+						continue;
+					}
+					v[1 + c] = metrics[c]->compute(*processed[c], ws);
+					sum += weights[c] * static_cast<double>(v[1 + c]);
+					sum_weights += weights[c];
+				}
+				v[0] = sum_weights > 0.0 ? static_cast<float>(sum / sum_weights) : 0.0f;
+			}
+		}
+	private:
+		std::unique_ptr<SSIM> metrics[3];
+		double weights[3];
+	};
+
+	// EW-PSNR, weighted by the gazes of the frame
+	class EWPSNRProvider : public Provider {
+	public:
+		explicit EWPSNRProvider(EWPSNR *m) : metric(m) {}
+		void compute(const FrameSet& set, int frame, Workspace& ws, float *values) const
+		{
+			metric->set_frame_no(ws, static_cast<unsigned int>(frame));
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				columns(values, 1, i, 0)[0] = metric->compute(set.original, set.processed[i], ws);
+			}
+		}
+	private:
+		std::unique_ptr<EWPSNR> metric;
+	};
+
+	// MS-SSIM, and SSIM which is its first level
+	class MSSSIMProvider : public Provider {
+	public:
+		explicit MSSSIMProvider(MSSSIM *m) : metric(m) {}
+		void compute(const FrameSet& set, int /* frame */, Workspace& ws, float *values) const
+		{
+			metric->setReference(set.original, ws);
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				metric->compute(set.processed[i], ws);
+				columns(values, 2, i, 0)[0] = metric->getMSSSIM(ws);
+				columns(values, 2, i, 1)[0] = metric->getSSIM(ws);
+			}
+		}
+	private:
+		std::unique_ptr<MSSSIM> metric;
+	};
+
+	// PSNR-HVS and PSNR-HVS-M, which are always computed together
+	class PSNRHVSProvider : public Provider {
+	public:
+		explicit PSNRHVSProvider(PSNRHVS *m) : metric(m) {}
+		void compute(const FrameSet& set, int /* frame */, Workspace& ws, float *values) const
+		{
+			metric->setReference(set.original, ws);
+			for (size_t i = 0; i < set.processed.size(); i++) {
+				metric->compute(set.processed[i], ws);
+				columns(values, 2, i, 0)[0] = metric->getPSNRHVS(ws);
+				columns(values, 2, i, 1)[0] = metric->getPSNRHVSM(ws);
+			}
+		}
+	private:
+		std::unique_ptr<PSNRHVS> metric;
+	};
+
+	Provider *createPSNR(const MetricRegistry::Parameters& params)
+	{
+		return new PSNRProvider(new PSNR(params.height, params.width, CV_32F, params.bitdepth), 1, params.yuv_weights);
+	}
+
+	Provider *createYUVPSNR(const MetricRegistry::Parameters& params)
+	{
+		return new PSNRProvider(new PSNR(params.height, params.width, CV_32F, params.bitdepth), 3, params.yuv_weights);
+	}
+
+	Provider *createEWPSNR(const MetricRegistry::Parameters& params)
+	{
+		EWPSNR *ewpsnr = new EWPSNR(params.height, params.width, params.bitdepth);
+		ewpsnr->match_eye_track_data(params.original_file);
+		return new EWPSNRProvider(ewpsnr);
+	}
+
+	Provider *createSSIM(const MetricRegistry::Parameters& params)
+	{
+		return new ReferenceProvider<SSIM>(new SSIM(params.height, params.width, CV_32F, params.bitdepth));
+	}
+
+	Provider *createYUVSSIM(const MetricRegistry::Parameters& params)
+	{
+		// SSIM does not depend on the size given to it, the chroma planes
+		// are filtered at their own size
+		return new YUVSSIMProvider(new SSIM(params.height, params.width, CV_32F, params.bitdepth),
+			new SSIM(params.height, params.width, CV_32F, params.bitdepth),
+			new SSIM(params.height, params.width, CV_32F, params.bitdepth), params.yuv_weights);
+	}
+
+	Provider *createMSSSIM(const MetricRegistry::Parameters& params)
+	{
+		return new MSSSIMProvider(new MSSSIM(params.height, params.width, params.bitdepth));
+	}
+
+	Provider *createVIFP(const MetricRegistry::Parameters& params)
+	{
+		return new ReferenceProvider<VIFP>(new VIFP(params.height, params.width, params.bitdepth));
+	}
+
+	Provider *createPSNRHVS(const MetricRegistry::Parameters& params)
+	{
+		return new PSNRHVSProvider(new PSNRHVS(params.height, params.width, params.bitdepth));
+	}
+
+	Provider *createWSPSNR(const MetricRegistry::Parameters& params)
+	{
+		return new WSPSNRProvider(new WSPSNR(params.height, params.width, params.chroma_height, params.bitdepth), 1, params.yuv_weights);
+	}
+
+	Provider *createYUVWSPSNR(const MetricRegistry::Parameters& params)
+	{
+		return new WSPSNRProvider(new WSPSNR(params.height, params.width, params.chroma_height, params.bitdepth), 3, params.yuv_weights);
+	}
+
+	// Providers, in the order they are computed
+	const Declaration DECLARATIONS[] = {
+		{"PSNR", {METRIC_PSNR, -1}, 1, 1, MetricRegistry::INPUT_PLANES, 1, createPSNR},
+		{"EW-PSNR", {METRIC_EWPSNR, -1}, 1, 1, MetricRegistry::INPUT_LUMA, 1, createEWPSNR},
+		{"YUV-PSNR", {METRIC_YUVPSNR, -1}, 1, 1, MetricRegistry::INPUT_PLANES, 1, createYUVPSNR},
+		{"SSIM", {METRIC_SSIM, -1}, 1, 1, MetricRegistry::INPUT_LUMA, 1, createSSIM},
+		{"YUV-SSIM", {METRIC_YUVSSIM, -1}, 1, 1, MetricRegistry::INPUT_YUV, 1, createYUVSSIM},
+		{"MS-SSIM", {METRIC_MSSSIM, METRIC_SSIM}, 2, 1, MetricRegistry::INPUT_LUMA, 16, createMSSSIM},
+		{"VIFp", {METRIC_VIFP, -1}, 1, 1, MetricRegistry::INPUT_LUMA, 8, createVIFP},
+		{"PSNR-HVS", {METRIC_PSNRHVS, METRIC_PSNRHVSM}, 2, 2, MetricRegistry::INPUT_LUMA, 8, createPSNRHVS},
+		{"WS-PSNR", {METRIC_WSPSNR, -1}, 1, 1, MetricRegistry::INPUT_PLANES, 1, createWSPSNR},
+		{"YUV-WS-PSNR", {METRIC_YUVWSPSNR, -1}, 1, 1, MetricRegistry::INPUT_PLANES, 1, createYUVWSPSNR}
+	};
+	const size_t NB_DECLARATIONS = sizeof(DECLARATIONS) / sizeof(DECLARATIONS[0]);
+
+	// Whether the provider computes the metric, as a primary one or not
+	bool computes(const Declaration& d, int metric, bool primary)
+	{
+		const int n = primary ? d.nbprimary : d.nbmetrics;
+		for (int k = 0; k < n; k++) {
+			if (d.metrics[k] == metric) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+Provider::~Provider()
+{
+}
+
+void Provider::summary(const std::vector<Workspace>& /* workspaces */, size_t /* i */, int /* k */, FILE * /* file */) const
+{
+}
+
+int MetricRegistry::find(const char *name)
+{
+	// Y-PSNR is the PSNR of the luma plane
+	if (strcmp(name, "YPSNR") == 0) {
+		return METRIC_PSNR;
+	}
+	for (int m = 0; m < METRIC_SIZE; m++) {
+		if (strcmp(name, METRIC_NAMES[m][0]) == 0) {
+			return m;
+		}
+	}
+	return -1;
+}
+
+const char *MetricRegistry::suffix(int metric)
+{
+	return METRIC_NAMES[metric][1];
+}
+
+int MetricRegistry::columns(int metric)
+{
+	return isYUV(metric) ? 4 : 1;
+}
+
+const char *MetricRegistry::header(int metric)
+{
+	return isYUV(metric) ? "value,y,u,v" : "value";
+}
+
+MetricRegistry::MetricRegistry(const bool *requested)
+{
+	// A provider is selected by its requested primary metrics
+	std::vector<bool> needed(NB_DECLARATIONS, false);
+	for (size_t d = 0; d < NB_DECLARATIONS; d++) {
+		for (int k = 0; k < DECLARATIONS[d].nbprimary; k++) {
+			needed[d] = needed[d] || requested[DECLARATIONS[d].metrics[k]];
+		}
+	}
+	// A metric which another needed provider computes for free does not
+	// select its own provider
+	for (size_t d = 0; d < NB_DECLARATIONS; d++) {
+		if (!needed[d]) {
+			continue;
+		}
+		for (int k = DECLARATIONS[d].nbprimary; k < DECLARATIONS[d].nbmetrics; k++) {
+			const int m = DECLARATIONS[d].metrics[k];
+			if (!requested[m]) {
+				continue;
+			}
+			for (size_t o = 0; o < NB_DECLARATIONS; o++) {
+				bool other_needed = false;
+				for (int j = 0; j < DECLARATIONS[o].nbprimary; j++) {
+					const int om = DECLARATIONS[o].metrics[j];
+					other_needed = other_needed || (om != m && requested[om]);
+				}
+				if (o != d && computes(DECLARATIONS[o], m, true) && !other_needed) {
+					needed[o] = false;
+				}
+			}
+		}
+	}
+
+	for (int m = 0; m < METRIC_SIZE; m++) {
+		sources[m] = -1;
+	}
+	for (size_t d = 0; d < NB_DECLARATIONS; d++) {
+		if (!needed[d]) {
+			continue;
+		}
+		const Declaration& decl = DECLARATIONS[d];
+		for (int k = 0; k < decl.nbmetrics; k++) {
+			const int m = decl.metrics[k];
+			if (requested[m] && sources[m] < 0) {
+				sources[m] = static_cast<int>(selected.size());
+			}
+		}
+		selected.push_back(&decl);
+	}
+}
+
+MetricRegistry::~MetricRegistry()
+{
+	for (size_t p = 0; p < providers.size(); p++) {
+		delete providers[p];
+	}
+}
+
+bool MetricRegistry::checkSize(int height, int width) const
+{
+	for (size_t p = 0; p < selected.size(); p++) {
+		const int multiple = selected[p]->multiple;
+		if (height % multiple != 0 || width % multiple != 0) {
+			fprintf(stderr, "%s: 'height' and 'width' have to be multiple of %d.\n", selected[p]->name, multiple);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool MetricRegistry::needs(Input input) const
+{
+	for (size_t p = 0; p < selected.size(); p++) {
+		if (selected[p]->input == input) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void MetricRegistry::create(const Parameters& params)
+{
+	for (size_t p = 0; p < selected.size(); p++) {
+		providers.push_back(selected[p]->create(params));
+	}
+}
+
+size_t MetricRegistry::size() const
+{
+	return selected.size();
+}
+
+const Declaration& MetricRegistry::declaration(size_t p) const
+{
+	return *selected[p];
+}
+
+const Provider& MetricRegistry::provider(size_t p) const
+{
+	return *providers[p];
+}
+
+int MetricRegistry::source(int metric) const
+{
+	return sources[metric];
+}
+
+void MetricRegistry::summary(int metric, size_t i, const std::vector<Workspace>& workspaces, FILE *file) const
+{
+	const size_t p = static_cast<size_t>(sources[metric]);
+	const Declaration& decl = *selected[p];
+	for (int k = 0; k < decl.nbmetrics; k++) {
+		if (decl.metrics[k] == metric) {
+			providers[p]->summary(workspaces, i, k, file);
+		}
+	}
+}
@@ -23,23 +23,100 @@
 //
 
 #include "PSNR.hpp"
+#include "Kernels.hpp"
 
-PSNR::PSNR(int h, int w, int t) : Metric(h, w, t),
-  tmp(h, w, t)
+PSNR::SquaredErrors::SquaredErrors()
+{
+	for (int c = 0; c < 3; c++) {
+		sse[c] = 0;
+		samples[c] = 0;
+	}
+}
+
+PSNR::SquaredErrors& PSNR::SquaredErrors::operator+=(const SquaredErrors& other)
+{
+	for (int c = 0; c < 3; c++) {
+		sse[c] += other.sse[c];
+		samples[c] += other.samples[c];
+	}
+	return *this;
+}
+
+PSNR::PSNR(int h, int w, int t, int bitdepth) : Metric(h, w, t, bitdepth)
 {
 }
 
-float PSNR::compute(const cv::Mat& original, const cv::Mat& processed)
+float PSNR::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& /* ws */) const
 {
-	cv::subtract(original, processed, tmp);
-	cv::multiply(tmp, tmp, tmp);
+	// The channels have the same number of samples, so the mean of the
+	// per-channel MSEs is the MSE over all the samples
+	const int n = original.cols * original.channels();
+	double res = 0.0;
+	for (int y = 0; y < original.rows; ++y) {
+		res += Kernels::sumSquaredDiff(original.ptr<float>(y), processed.ptr<float>(y), n);
+	}
+	res /= static_cast<double>(n) * original.rows;
+
+	return float(10.0 * log10(static_cast<double>(peak) * static_cast<double>(peak) / res));
+}
 
-	cv::Scalar tmp_mean = cv::mean(tmp);
-	double res = tmp_mean.val[0];
-	for (int i = 1; i < original.channels(); ++i) {
-		res += tmp_mean.val[i];
+PSNR::SquaredErrors PSNR::squaredErrors(const cv::Mat *original, const cv::Mat *processed, int nbplanes)
+{
+	SquaredErrors errors;
+	for (int c = 0; c < nbplanes; c++) {
+		errors.sse[c] = sumSquaredDiff(original[c], processed[c]);
+		errors.samples[c] = original[c].total();
 	}
-	res /= original.channels();
+	return errors;
+}
 
-	return float(10.0 * log10(255.0 * 255.0 / res));
+float PSNR::compute(const SquaredErrors& errors) const
+{
+	return fromMSE(static_cast<double>(errors.sse[0]) / static_cast<double>(errors.samples[0]));
+}
+
+float PSNR::compute(const SquaredErrors& errors, const double *weights, float *planes) const
+{
+	// The mean squared errors of the planes are combined, so that the
+	// chroma planes count as if upsampled to the luma size whatever their
+	// number of samples
+	double sum = 0.0;
+	double sum_weights = 0.0;
+	for (int c = 0; c < 3; c++) {
+		planes[c] = 0.0f;
+		if (errors.samples[c] == 0) {
+			continue;
+		}
+		double mse = static_cast<double>(errors.sse[c]) / static_cast<double>(errors.samples[c]);
+		planes[c] = fromMSE(mse);
+		sum += weights[c] * mse;
+		sum_weights += weights[c];
+	}
+
+	return sum_weights > 0.0 ? fromMSE(sum / sum_weights) : 0.0f;
+}
+
+float PSNR::fromMSE(double mse) const
+{
+	return float(10.0 * log10(static_cast<double>(peak) * static_cast<double>(peak) / mse));
+}
+
+uint64_t PSNR::sumSquaredDiff(const cv::Mat& a, const cv::Mat& b)
+{
+	int rows = a.rows;
+	int cols = a.cols;
+	if (a.isContinuous() && b.isContinuous()) {
+		cols *= rows;
+		rows = 1;
+	}
+	uint64_t sse = 0;
+	for (int y = 0; y < rows; ++y) {
+		if (a.depth() == CV_16U) {
+			sse += Kernels::sumSquaredDiff(a.ptr<unsigned short>(y), b.ptr<unsigned short>(y), cols);
+		}
+		else {
+			sse += Kernels::sumSquaredDiff(a.ptr<unsigned char>(y), b.ptr<unsigned char>(y), cols);
+		}
+	}
+	return sse;
 }
@@ -39,8 +39,10 @@
 //   Processing and Quality Metrics for Consumer Electronics, January 2007.
 //
 
+#include <algorithm>
 #include <cfloat>
 #include "PSNRHVS.hpp"
+#include "Kernels.hpp"
 
 const float PSNRHVS::CSF[8][8]  =	{{1.608443f, 2.339554f, 2.573509f, 1.608443f, 1.072295f, 0.643377f, 0.504610f, 0.421887f},
 									 {2.144591f, 2.144591f, 1.838221f, 1.354478f, 0.989811f, 0.443708f, 0.428918f, 0.467911f},
@@ -60,75 +62,105 @@ const float PSNRHVS::MASK[8][8] =	{{0.390625f, 0.826446f, 1.000000f, 0.390625f,
 									 {0.041649f, 0.024414f, 0.016437f, 0.013212f, 0.009426f, 0.006830f, 0.006944f, 0.009803f},
 									 {0.019290f, 0.011815f, 0.011080f, 0.010412f, 0.007972f, 0.010000f, 0.009426f, 0.010203f}};
 
-PSNRHVS::PSNRHVS(int h, int w) : Metric(h, w),
-	a(8,8,CV_32F), b(8,8,CV_32F), a_dct(8,8,CV_32F), b_dct(8,8,CV_32F)
+struct PSNRHVS::State : Workspace::State {
+	float psnrhvs = 0.0f;
+	float psnrhvsm = 0.0f;
+	std::vector<BlockBuffers> buffers;
+	// DCT coefficients (one row per block) and masking of the original blocks
+	cv::Mat ref_dct;
+	std::vector<float> ref_mask;
+};
+
+PSNRHVS::PSNRHVS(int h, int w, int bitdepth) : Metric(h, w, CV_32F, bitdepth)
 {
 }
 
-float PSNRHVS::getPSNRHVS()
+float PSNRHVS::getPSNRHVS(Workspace& ws) const
 {
-	return psnrhvs;
+	return ws.state<State>(this).psnrhvs;
 }
 
-float PSNRHVS::getPSNRHVSM()
+float PSNRHVS::getPSNRHVSM(Workspace& ws) const
 {
-	return psnrhvsm;
+	return ws.state<State>(this).psnrhvsm;
 }
 
-float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed)
+float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const
 {
-	float s1 = 0.0f;
-	float s2 = 0.0f;
-	float num = static_cast<float>(width*height);
-	float tmp;
+	setReference(original, ws);
+	return compute(processed, ws);
+}
 
-	for (int y=0; y<height; y+=8) {
-		for (int x=0; x<width; x+=8) {
+void PSNRHVS::setReference(const cv::Mat& original, Workspace& ws) const
+{
+	const int blocks_per_row = width/8;
+	State& st = prepareBuffers(ws);
+	cv::Mat& ref_dct = st.ref_dct;
+	std::vector<float>& ref_mask = st.ref_mask;
+	ref_dct.create((height/8)*blocks_per_row, 64, CV_32F);
+	ref_mask.resize(size_t((height/8)*blocks_per_row));
+
+	forEachBand(ws, bandCount(height), [&](int, int band) {
+		const int y1 = std::min(height/8*8, (band+1) * BAND_ROWS);
+		for (int y=band*BAND_ROWS; y<y1; y+=8) {
+			int block = (y/8) * blocks_per_row;
 			// a = img1(y:y+7,x:x+7);
-			a = original(cv::Range(y,y+8),cv::Range(x,x+8));
-			// b = img2(y:y+7,x:x+7);
-			b = processed(cv::Range(y,y+8),cv::Range(x,x+8));
 			// a_dct = dct2(a);
-			cv::dct(a, a_dct);
-			// b_dct = dct2(b);
-			cv::dct(b, b_dct);
-
 			// mask_a = maskeff(a,a_dct);
-			float mask_a = maskeff(a,a_dct);
+			Kernels::hvsTransform(original.ptr<float>(y), original.step1(), blocks_per_row, MASK[0],
+				ref_dct.ptr<float>(block), &ref_mask[size_t(block)]);
+		}
+	});
+}
+
+float PSNRHVS::compute(const cv::Mat& processed, Workspace& ws) const
+{
+	const double num = static_cast<double>(width*height);
+	const int blocks_per_row = width/8;
+	const int nbands = bandCount(height);
+	double *sums = ws.getArena().allocate<double>(static_cast<size_t>(nbands) * 2);
+	State& st = prepareBuffers(ws);
+	const cv::Mat& ref_dct = st.ref_dct;
+	const std::vector<float>& ref_mask = st.ref_mask;
+
+	// The bands are made of whole rows of blocks, whose DCT and masking are
+	// computed at once, their sums are added in order once all of them are
+	// computed
+	forEachBand(ws, nbands, [&](int worker, int band) {
+		BlockBuffers& buf = st.buffers[static_cast<size_t>(worker)];
+		double band_s1 = 0.0;
+		double band_s2 = 0.0;
+		const int y1 = std::min(height/8*8, (band+1) * BAND_ROWS);
+		for (int y=band*BAND_ROWS; y<y1; y+=8) {
+			int block = (y/8) * blocks_per_row;
+			// b = img2(y:y+7,x:x+7);
+			// b_dct = dct2(b);
 			// mask_b = maskeff(b,b_dct);
-			float mask_b = maskeff(b,b_dct);
-
-			// if mask_b > mask_a: mask_a = mask_b;
-			mask_a = mask_b > mask_a ? mask_b : mask_a;
-
-			for (int k=0; k<8; k++) {
-				const float *ptr_a = a_dct.ptr<float>(k);
-				const float *ptr_b = b_dct.ptr<float>(k);
-				for (int l=0; l<8; l++) {
-					// u = abs(a_dct(k,l)-b_dct(k,l));
-					float u = std::abs(*ptr_a++ - *ptr_b++);
-					// s2 = s2 + (u*CSF(k,l)).^2;
-					tmp = u*CSF[k][l];
-					s2 += tmp*tmp;
-					// if (k~=1) | (l~=1)
-					if (k != 0 || l !=0) {
-						// if u < mask_a/mask(k,l)
-						tmp = mask_a/MASK[k][l];
-						if (u < tmp) {
-							// u = 0;
-							u = 0;
-						}
-						else {
-							// u = u - mask_a/mask(k,l);
-							u -= tmp;
-						}
-					}
-					// s1 = s1 + (u*CSF(k,l)).^2;
-					tmp = u*CSF[k][l];
-					s1 += tmp*tmp;
-				}
+			Kernels::hvsTransform(processed.ptr<float>(y), processed.step1(), blocks_per_row, MASK[0],
+				buf.dct.data(), buf.mask.data());
+
+			for (int x=0; x<blocks_per_row; x++) {
+				// mask_a = maskeff(a,a_dct);
+				float mask_a = ref_mask[size_t(block)];
+				float mask_b = buf.mask[size_t(x)];
+
+				// if mask_b > mask_a: mask_a = mask_b;
+				mask_a = mask_b > mask_a ? mask_b : mask_a;
+
+				// s1 and s2 accumulation over the 64 coefficients of the block
+				Kernels::hvsBlock(ref_dct.ptr<float>(block), &buf.dct[size_t(x)*64], CSF[0], MASK[0], mask_a, band_s1, band_s2);
+				block++;
 			}
 		}
+		sums[static_cast<size_t>(band) * 2] = band_s1;
+		sums[static_cast<size_t>(band) * 2 + 1] = band_s2;
+	});
+
+	double s1 = 0.0;
+	double s2 = 0.0;
+	for (int band = 0; band < nbands; band++) {
+		s1 += sums[static_cast<size_t>(band) * 2];
+		s2 += sums[static_cast<size_t>(band) * 2 + 1];
 	}
 
 	// s1 = s1/num;
@@ -138,73 +170,21 @@ float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed)
 
 	// if s1 == 0: p_hvs_m = 100000;
 	// else: p_hvs_m = 10*log10(255*255/s1);
-	psnrhvsm = s1 <= FLT_EPSILON ? 100000.0f : float(10*log10(255*255/s1));
+	st.psnrhvsm = s1 <= static_cast<double>(FLT_EPSILON) ? 100000.0f : float(10*log10(static_cast<double>(peak*peak)/s1));
 	// if s2 == 0: p_hvs = 100000;
 	// else: p_hvs = 10*log10(255*255/s2);
-	psnrhvs = s2 <= FLT_EPSILON ? 100000.0f : float(10*log10(255*255/s2));
+	st.psnrhvs = s2 <= static_cast<double>(FLT_EPSILON) ? 100000.0f : float(10*log10(static_cast<double>(peak*peak)/s2));
 
-	return psnrhvsm;
+	return st.psnrhvsm;
 }
 
-float PSNRHVS::maskeff(const cv::Mat &z, const cv::Mat &zdct)
+PSNRHVS::State& PSNRHVS::prepareBuffers(Workspace& ws) const
 {
-	float m = 0;
-
-	float val;
-	for (int k=0; k<8; k++) {
-		const float* ptr = zdct.ptr<float>(k);
-		for (int l=0; l<8; l++) {
-			val = *ptr++;
-			// if (k~=1) | (l~=1): m = m + (zdct(k,l).^2) * mask(k,l);
-			if (k!=0 || l!=0) m += val*val*MASK[k][l];
-		}
+	State& st = ws.state<State>(this);
+	st.buffers.resize(static_cast<size_t>(workerCount(ws)));
+	for (size_t w = 0; w < st.buffers.size(); w++) {
+		st.buffers[w].dct.resize(static_cast<size_t>(width/8) * 64);
+		st.buffers[w].mask.resize(static_cast<size_t>(width/8));
 	}
-
-	// pop=vari(z);
-	float pop = vari(z);
-	// if pop ~= 0: pop=(vari(z(1:4,1:4))+vari(z(1:4,5:8))+vari(z(5:8,5:8))+vari(z(5:8,1:4)))/pop;
-	if (fabsf(pop) > FLT_EPSILON) {
-		pop = (vari(z(cv::Range(0,4),cv::Range(0,4)))
-			+vari(z(cv::Range(0,4),cv::Range(4,8)))
-			+vari(z(cv::Range(4,8),cv::Range(4,8)))
-			+vari(z(cv::Range(4,8),cv::Range(0,4)))) / pop;
-	}
-
-	// m = sqrt(m*pop)/32;
-	return sqrtf(m*pop)/32.0f;
-}
-
-float PSNRHVS::vari(const cv::Mat &z)
-{
-	int w = z.cols;
-	int h = z.rows;
-
-	// d=var(AA(:))*length(AA(:));
-
-	{
-		cv::meanStdDev(z, mean_mat, stddev_mat);
-		double d = stddev_mat.at<double>(0);
-		double N = static_cast<double>(h*w);
-		d = d * d * N * N / (N - 1);
-
-		return static_cast<float>(d);
-	}
-
-	float mean = 0.0;
-	float d = 0.0;
-	float N = static_cast<float>(h*w);
-
-	for (int i=0; i<h; i++) {
-		const float *ptr = z.ptr<float>(i);
-		for (int j=0; j<w; j++) {
-			d += (*ptr)*(*ptr);
-			mean += *ptr++;
-		}
-	}
-	d /= N;
-	mean /= N;
-	d -= mean*mean;
-	d *= N*N/(N-1);
-
-	return d;
+	return st;
 }
@@ -33,62 +33,101 @@
 //   Transactions on Image Processing, vol. 13, no. 4, pp. 600–612, April 2004.
 //
 
+#include <algorithm>
 #include "SSIM.hpp"
 
 namespace {
+	// Constants for 8-bit samples: (0.01*255)^2 and (0.03*255)^2
 	const float C1 = 6.5025f;
 	const float C2 = 58.5225f;
-
-	const cv::Scalar scC1(C1, C1, C1);
-	const cv::Scalar scC2(C2, C2, C2);
+	// Standard deviation of the Gaussian window
+	const double GK_SIGMA = 1.5;
+
+	// Add the values of channel c of one filtered row of the SSIM map to
+	// ssim_row when SSIM_TERM, and of the CS map to cs_row when CS_TERM
+	// Without SSIM_TERM the luminance term, and its division, is skipped.
+	template <bool SSIM_TERM, bool CS_TERM>
+	inline void sumMaps(const float *m1, const float *h2, const float *m11, const float *h22, const float *h12,
+		int c, int len, int cn, float c1, float c2, float& ssim_row, float& cs_row)
+	{
+		for (int i = c; i < len; i += cn) {
+			float mu1_sq = m1[i] * m1[i];
+			float mu2_sq = h2[i] * h2[i];
+			float mu1_mu2 = m1[i] * h2[i];
+			float sigma1_sq = m11[i] - mu1_sq;
+			float sigma2_sq = h22[i] - mu2_sq;
+			float sigma12 = h12[i] - mu1_mu2;
+			float cs = (2 * sigma12 + c2) / (sigma1_sq + sigma2_sq + c2);
+			if (CS_TERM) {
+				cs_row += cs;
+			}
+			if (SSIM_TERM) {
+				ssim_row += cs * (2 * mu1_mu2 + c1) / (mu1_sq + mu2_sq + c1);
+			}
+		}
+	}
 }
 
 enum {
 	SSIM_SIZE = 8,
 	GK_SIZE = 11,
+	// Number of output columns processed at once by the fused kernel, such
+	// that the GK_SIZE input rows of a tile stay in the L1 cache
+	TILE_SIZE = 256,
+	// Maximum number of channels
+	MAX_CN = 4
 };
 
-SSIM::SSIM(int h, int w, int t) : Metric(h, w, t),
-  mu1(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  mu2(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  mu1_sq(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  mu2_sq(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  mu1_mu2(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  img1_sq(h, w, t),
-  img2_sq(h, w, t),
-  img1_img2(h, w, t),
-  sigma1_sq(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  sigma2_sq(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t),
-  sigma12(h - (GK_SIZE - 1), w - (GK_SIZE - 1), t)
+struct SSIM::State : Workspace::State {
+	// Line buffers of the fused kernel, one per worker: vertically filtered
+	// then fully filtered x, y, x^2, y^2 and xy for one tile of one row
+	std::vector<cv::Mat> lines;
+	// Reference image and its filtered x and x^2
+	cv::Mat ref, ref_mu, ref_sq;
 
 #if defined(HAVE_SSIM_BLUR_8)
-  ,
-  bmu1(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bmu2(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bmu1_sq(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bmu2_sq(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bmu1_mu2(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bsigma1_sq(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bsigma2_sq(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t),
-  bsigma12(h - (SSIM_SIZE - 1), w - (SSIM_SIZE - 1), t)
+	LineBuffers blur_lines;
+	cv::Mat img1_sq, img2_sq, img1_img2;
+	cv::Mat bmu1, bmu2;
+	cv::Mat bmu1_sq, bmu2_sq, bmu1_mu2;
+	cv::Mat bsigma1_sq, bsigma2_sq, bsigma12;
 #endif
+};
+
+SSIM::SSIM(int h, int w, int t, int bitdepth) : Metric(h, w, t, bitdepth),
+  c1(C1 * range_sq), c2(C2 * range_sq),
+  window(cv::getGaussianKernel(GK_SIZE, GK_SIGMA, CV_32F))
 {
 }
 
-float SSIM::compute(const cv::Mat& original, const cv::Mat& processed)
+float SSIM::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const
 {
-	cv::Scalar res = computeSSIM(original, processed);
+	cv::Scalar res = computeSSIM(original, processed, ws);
 	return float(res.val[0]);
 }
 
 #if defined(HAVE_SSIM_BLUR_8)
-cv::Scalar SSIM::compute_x8(const cv::Mat& img1, const cv::Mat& img2)
+cv::Scalar SSIM::compute_x8(const cv::Mat& img1, const cv::Mat& img2, Workspace& ws) const
 {
+	State& st = ws.state<State>(this);
+	LineBuffers& buf = st.blur_lines;
+	cv::Mat& img1_sq = st.img1_sq;
+	cv::Mat& img2_sq = st.img2_sq;
+	cv::Mat& img1_img2 = st.img1_img2;
+	cv::Mat& bmu1 = st.bmu1;
+	cv::Mat& bmu2 = st.bmu2;
+	cv::Mat& bmu1_sq = st.bmu1_sq;
+	cv::Mat& bmu2_sq = st.bmu2_sq;
+	cv::Mat& bmu1_mu2 = st.bmu1_mu2;
+	cv::Mat& bsigma1_sq = st.bsigma1_sq;
+	cv::Mat& bsigma2_sq = st.bsigma2_sq;
+	cv::Mat& bsigma12 = st.bsigma12;
+
 	// mu1 = filter2(window, img1, 'valid');
-	applyBlur(img1, bmu1, SSIM_SIZE);
+	applyBlur(img1, bmu1, SSIM_SIZE, buf);
 
 	// mu2 = filter2(window, img2, 'valid');
-	applyBlur(img2, bmu2, SSIM_SIZE);
+	applyBlur(img2, bmu2, SSIM_SIZE, buf);
 
 	// mu1_sq = mu1.*mu1;
 	cv::multiply(bmu1, bmu1, bmu1_sq);
@@ -102,36 +141,36 @@ cv::Scalar SSIM::compute_x8(const cv::Mat& img1, const cv::Mat& img2)
 	cv::multiply(img1, img2, img1_img2);
 
 	// sigma1_sq = filter2(window, img1.*img1, 'valid') - mu1_sq;
-	applyBlur(img1_sq, bsigma1_sq, SSIM_SIZE);
+	applyBlur(img1_sq, bsigma1_sq, SSIM_SIZE, buf);
 	bsigma1_sq -= bmu1_sq;
 
 	// sigma2_sq = filter2(window, img2.*img2, 'valid') - mu2_sq;
-	applyBlur(img2_sq, bsigma2_sq, SSIM_SIZE);
+	applyBlur(img2_sq, bsigma2_sq, SSIM_SIZE, buf);
 	bsigma2_sq -= bmu2_sq;
 
 	// sigma12 = filter2(window, img1.*img2, 'valid') - mu1_mu2;
-	applyBlur(img1_img2, bsigma12, SSIM_SIZE);
+	applyBlur(img1_img2, bsigma12, SSIM_SIZE, buf);
 	bsigma12 -= bmu1_mu2;
 
 	// cs_map = (2*sigma12 + C2)./(sigma1_sq + sigma2_sq + C2);
 	cv::Mat& tmp1 = bsigma12;
 	tmp1 *= 2;
-	tmp1 += scC2;
+	tmp1 += cv::Scalar::all(c2);
 
 	cv::Mat& tmp2 = bsigma1_sq;
 	tmp2 += bsigma2_sq;
-	tmp2 += scC2;
+	tmp2 += cv::Scalar::all(c2);
 
 	cv::divide(tmp1, tmp2, tmp1);
 
 	// ssim_map = ((2*mu1_mu2 + C1).*(2*sigma12 + C2))./((mu1_sq + mu2_sq + C1).*(sigma1_sq + sigma2_sq + C2));
 	cv::Mat& tmp3 = bmu1_mu2;
 	tmp3 *= 2;
-	tmp3 += scC1;
+	tmp3 += cv::Scalar::all(c1);
 
 	cv::Mat& tmp4 = bmu1_sq;
 	tmp4 += bmu2_sq;
-	tmp4 += scC1;
+	tmp4 += cv::Scalar::all(c1);
 
 	cv::multiply(tmp3, tmp1, tmp3);
 	cv::divide(tmp3, tmp4, tmp3);
@@ -142,77 +181,271 @@ cv::Scalar SSIM::compute_x8(const cv::Mat& img1, const cv::Mat& img2)
 }
 #endif
 
-cv::Scalar SSIM::computeSSIM(const cv::Mat& img1, const cv::Mat& img2)
+void SSIM::setReference(const cv::Mat& original, Workspace& ws) const
 {
-	// mu1 = filter2(window, img1, 'valid');
-	applyGaussianBlur(img1, mu1, GK_SIZE, 1.5);
-
-	// mu2 = filter2(window, img2, 'valid');
-	applyGaussianBlur(img2, mu2, GK_SIZE, 1.5);
-
-	// mu1_sq = mu1.*mu1;
-	cv::multiply(mu1, mu1, mu1_sq);
-	// mu2_sq = mu2.*mu2;
-	cv::multiply(mu2, mu2, mu2_sq);
-	// mu1_mu2 = mu1.*mu2;
-	cv::multiply(mu1, mu2, mu1_mu2);
-
-	cv::multiply(img1, img1, img1_sq);
-	cv::multiply(img2, img2, img2_sq);
-	cv::multiply(img1, img2, img1_img2);
-
-	// sigma1_sq = filter2(window, img1.*img1, 'valid') - mu1_sq;
-	applyGaussianBlur(img1_sq, sigma1_sq, GK_SIZE, 1.5);
-	sigma1_sq -= mu1_sq;
+	State& st = ws.state<State>(this);
+	st.ref = original;
+	referenceMoments(st.ref, st.ref_mu, st.ref_sq, ws);
+}
 
-	// sigma2_sq = filter2(window, img2.*img2, 'valid') - mu2_sq;
-	applyGaussianBlur(img2_sq, sigma2_sq, GK_SIZE, 1.5);
-	sigma2_sq -= mu2_sq;
+float SSIM::compute(const cv::Mat& processed, Workspace& ws) const
+{
+	const State& st = ws.state<State>(this);
+	cv::Scalar res = computeSSIM(st.ref, processed, ws, &st.ref_mu, &st.ref_sq);
+	return float(res.val[0]);
+}
 
-	// sigma12 = filter2(window, img1.*img2, 'valid') - mu1_mu2;
-	applyGaussianBlur(img1_img2, sigma12, GK_SIZE, 1.5);
-	sigma12 -= mu1_mu2;
+void SSIM::filterReference(const cv::Mat& img1, cv::Mat& mu, cv::Mat& sq, Workspace& ws) const
+{
+	// Same filtering as in computeSSIM(), for x and x^2 only
+	const int cn = img1.channels();
+	const int out_rows = img1.rows - (GK_SIZE - 1);
+	const int out_cols = img1.cols - (GK_SIZE - 1);
+
+	mu.create(out_rows, out_cols, CV_32FC(cn));
+	sq.create(out_rows, out_cols, CV_32FC(cn));
+
+	std::vector<cv::Mat>& lines = prepareLines(ws, cn);
+	forEachBand(ws, bandCount(out_rows), [&](int worker, int band) {
+		const int y0 = band * BAND_ROWS;
+		const int y1 = std::min(out_rows, y0 + BAND_ROWS);
+		filterReferenceBand(img1, mu, sq, y0, y1, lines[static_cast<size_t>(worker)]);
+	});
+}
 
-	// cs_map = (2*sigma12 + C2)./(sigma1_sq + sigma2_sq + C2);
-	cv::Mat& tmp1 = sigma12;
-	tmp1 *= 2;
-	tmp1 += scC2;
+void SSIM::filterReferenceBand(const cv::Mat& img1, cv::Mat& mu, cv::Mat& sq, int y0, int y1, cv::Mat& buf) const
+{
+	const int cn = img1.channels();
+	const int out_cols = img1.cols - (GK_SIZE - 1);
+	const float *g = window.ptr<float>(0);
+
+	for (int x0 = 0; x0 < out_cols; x0 += TILE_SIZE) {
+		const int tile = std::min(static_cast<int>(TILE_SIZE), out_cols - x0);
+		const int in_len = (tile + GK_SIZE - 1) * cn;
+		const int out_len = tile * cn;
+
+		float *v1 = buf.ptr<float>(0), *v11 = buf.ptr<float>(2);
+
+		for (int y = y0; y < y1; y++) {
+			for (int i = 0; i < in_len; i++) {
+				v1[i] = v11[i] = 0.0f;
+			}
+			for (int k = 0; k < GK_SIZE; k++) {
+				const float *p1 = img1.ptr<float>(y + k) + x0 * cn;
+				const float gk = g[k];
+				for (int i = 0; i < in_len; i++) {
+					float a = p1[i];
+					v1[i] += gk * a;
+					v11[i] += gk * a * a;
+				}
+			}
+
+			float *h1 = mu.ptr<float>(y) + x0 * cn;
+			float *h11 = sq.ptr<float>(y) + x0 * cn;
+			for (int i = 0; i < out_len; i++) {
+				h1[i] = h11[i] = 0.0f;
+			}
+			for (int k = 0; k < GK_SIZE; k++) {
+				const int off = k * cn;
+				const float gk = g[k];
+				for (int i = 0; i < out_len; i++) {
+					h1[i] += gk * v1[i + off];
+					h11[i] += gk * v11[i + off];
+				}
+			}
+		}
+	}
+}
 
-	cv::Mat& tmp2 = sigma1_sq;
-	tmp2 += sigma2_sq;
-	tmp2 += scC2;
+void SSIM::referenceMoments(const cv::Mat& img1, cv::Mat& mu, cv::Mat& sq, Workspace& ws) const
+{
+	FeatureCache *cache = ws.getCache();
+	cv::Mat *cached_mu, *cached_sq;
+	if (cache == nullptr) {
+		filterReference(img1, mu, sq, ws);
+		return;
+	}
+	if (!cache->moments(img1, GK_SIZE, GK_SIGMA, cached_mu, cached_sq)) {
+		filterReference(img1, *cached_mu, *cached_sq, ws);
+	}
+	mu = *cached_mu;
+	sq = *cached_sq;
+}
 
-	cv::divide(tmp1, tmp2, tmp1);
-	cv::Mat& cs_map = tmp1;
+cv::Scalar SSIM::computeSSIM(const cv::Mat& img1, const cv::Mat& img2, Workspace& ws,
+	const cv::Mat *mu1, const cv::Mat *sq1) const
+{
+	const int terms = SSIM_MEAN | CS_MEAN;
+	double mssim, mcs;
+	computeMeans(1, &img1, &img2, &terms, ws, &mssim, &mcs, mu1, sq1);
 
-	// ssim_map = ((2*mu1_mu2 + C1).*(2*sigma12 + C2))./((mu1_sq + mu2_sq + C1).*(sigma1_sq + sigma2_sq + C2));
-	cv::Mat& tmp3 = mu1_mu2;
-	tmp3 *= 2;
-	tmp3 += scC1;
+	cv::Scalar res(mssim, mcs);
 
-	cv::Mat& tmp4 = mu1_sq;
-	tmp4 += mu2_sq;
-	tmp4 += scC1;
+	return res;
+}
 
-	cv::multiply(tmp3, tmp1, tmp3);
-	cv::divide(tmp3, tmp4, tmp3);
-	cv::Mat& ssim_map = tmp3;
+void SSIM::computeMeans(int n, const cv::Mat *img1, const cv::Mat *img2, const int *terms, Workspace& ws,
+	double *mssim, double *mcs, const cv::Mat *mu1, const cv::Mat *sq1) const
+{
+	// The separable Gaussian filtering of x, y, x^2, y^2 and xy, the SSIM
+	// and CS maps and their means are computed in a single sweep over tiles
+	// of rows. Only the 'valid' part of the filtering is computed, which is
+	// what applyGaussianBlur() returns, so no full-frame buffer is needed.
+	// The filtered x and x^2 are read from mu1 and sq1 when given.
+	// Each image is split in bands of output rows, the bands of all images
+	// being numbered one after the other, and the sums of the bands of an
+	// image are added in order once all of them are computed.
+	const int cn = img1[0].channels();
+	int *first = ws.getArena().allocate<int>(static_cast<size_t>(n) + 1);
+	first[0] = 0;
+	for (int i = 0; i < n; i++) {
+		first[i+1] = first[i] + bandCount(img1[i].rows - (GK_SIZE - 1));
+	}
+	const int nbands = first[n];
+	const size_t nsums = static_cast<size_t>(nbands) * 2 * MAX_CN;
+	double *sums = ws.getArena().allocate<double>(nsums);
+	std::fill(sums, sums + nsums, 0.0);
+
+	std::vector<cv::Mat>& lines = prepareLines(ws, cn);
+	forEachBand(ws, nbands, [&](int worker, int band) {
+		double *ssim_sum = &sums[static_cast<size_t>(band) * 2 * MAX_CN];
+		const int i = static_cast<int>(std::upper_bound(first, first + n, band) - first) - 1;
+		const int out_rows = img1[i].rows - (GK_SIZE - 1);
+		const int y0 = (band - first[i]) * BAND_ROWS;
+		const int y1 = std::min(out_rows, y0 + BAND_ROWS);
+		computeSSIMBand(img1[i], img2[i], mu1 ? &mu1[i] : nullptr, sq1 ? &sq1[i] : nullptr,
+			y0, y1, terms[i], lines[static_cast<size_t>(worker)], ssim_sum, ssim_sum + MAX_CN);
+	});
 
 	// mssim = mean2(ssim_map);
-	cv::Scalar ssim_mean = cv::mean(ssim_map);
-	double mssim = ssim_mean.val[0];
 	// mcs = mean2(cs_map);
-	cv::Scalar cs_mean = cv::mean(cs_map);
-	double mcs = cs_mean.val[0];
-
-	for (int i = 1; i < img1.channels(); ++i) {
-		mssim += ssim_mean.val[i];
-		mcs += cs_mean.val[i];
+	for (int i = 0; i < n; i++) {
+		double ssim_total = 0.0;
+		double cs_total = 0.0;
+		for (int band = first[i]; band < first[i+1]; band++) {
+			const double *ssim_sum = &sums[static_cast<size_t>(band) * 2 * MAX_CN];
+			for (int c = 0; c < cn; c++) {
+				ssim_total += ssim_sum[c];
+				cs_total += ssim_sum[MAX_CN + c];
+			}
+		}
+		const double count = static_cast<double>(img1[i].rows - (GK_SIZE - 1)) * (img1[i].cols - (GK_SIZE - 1)) * cn;
+		if (terms[i] & SSIM_MEAN) {
+			mssim[i] = ssim_total / count;
+		}
+		if (terms[i] & CS_MEAN) {
+			mcs[i] = cs_total / count;
+		}
 	}
-	mssim /= img1.channels();
-	mcs /= img1.channels();
+}
 
-	cv::Scalar res(mssim, mcs);
+void SSIM::computeSSIMBand(const cv::Mat& img1, const cv::Mat& img2, const cv::Mat *mu1, const cv::Mat *sq1,
+	int y0, int y1, int terms, cv::Mat& buf, double *ssim_sum, double *cs_sum) const
+{
+	const bool has_ref = mu1 != nullptr && sq1 != nullptr;
+	const int cn = img1.channels();
+	const int out_cols = img1.cols - (GK_SIZE - 1);
+	const float *g = window.ptr<float>(0);
+
+	for (int x0 = 0; x0 < out_cols; x0 += TILE_SIZE) {
+		const int tile = std::min(static_cast<int>(TILE_SIZE), out_cols - x0);
+		// Number of input and output values of one row of the tile
+		const int in_len = (tile + GK_SIZE - 1) * cn;
+		const int out_len = tile * cn;
+
+		float *v1 = buf.ptr<float>(0), *v2 = buf.ptr<float>(1);
+		float *v11 = buf.ptr<float>(2), *v22 = buf.ptr<float>(3), *v12 = buf.ptr<float>(4);
+		float *h1 = buf.ptr<float>(5), *h2 = buf.ptr<float>(6);
+		float *h11 = buf.ptr<float>(7), *h22 = buf.ptr<float>(8), *h12 = buf.ptr<float>(9);
+
+		for (int y = y0; y < y1; y++) {
+			// Vertical filtering of the GK_SIZE input rows
+			for (int i = 0; i < in_len; i++) {
+				v1[i] = v2[i] = v11[i] = v22[i] = v12[i] = 0.0f;
+			}
+			for (int k = 0; k < GK_SIZE; k++) {
+				const float *p1 = img1.ptr<float>(y + k) + x0 * cn;
+				const float *p2 = img2.ptr<float>(y + k) + x0 * cn;
+				const float gk = g[k];
+				if (has_ref) {
+					for (int i = 0; i < in_len; i++) {
+						float a = p1[i];
+						float b = p2[i];
+						v2[i] += gk * b;
+						v22[i] += gk * b * b;
+						v12[i] += gk * a * b;
+					}
+				}
+				else {
+					for (int i = 0; i < in_len; i++) {
+						float a = p1[i];
+						float b = p2[i];
+						v1[i] += gk * a;
+						v2[i] += gk * b;
+						v11[i] += gk * a * a;
+						v22[i] += gk * b * b;
+						v12[i] += gk * a * b;
+					}
+				}
+			}
+
+			// Horizontal filtering
+			for (int i = 0; i < out_len; i++) {
+				h1[i] = h2[i] = h11[i] = h22[i] = h12[i] = 0.0f;
+			}
+			for (int k = 0; k < GK_SIZE; k++) {
+				const int off = k * cn;
+				const float gk = g[k];
+				if (has_ref) {
+					for (int i = 0; i < out_len; i++) {
+						h2[i] += gk * v2[i + off];
+						h22[i] += gk * v22[i + off];
+						h12[i] += gk * v12[i + off];
+					}
+				}
+				else {
+					for (int i = 0; i < out_len; i++) {
+						h1[i] += gk * v1[i + off];
+						h2[i] += gk * v2[i + off];
+						h11[i] += gk * v11[i + off];
+						h22[i] += gk * v22[i + off];
+						h12[i] += gk * v12[i + off];
+					}
+				}
+			}
+			const float *m1 = has_ref ? mu1->ptr<float>(y) + x0 * cn : h1;
+			const float *m11 = has_ref ? sq1->ptr<float>(y) + x0 * cn : h11;
+
+			// cs_map = (2*sigma12 + C2)./(sigma1_sq + sigma2_sq + C2);
+			// ssim_map = ((2*mu1_mu2 + C1).*(2*sigma12 + C2))./((mu1_sq + mu2_sq + C1).*(sigma1_sq + sigma2_sq + C2));
+			for (int c = 0; c < cn; c++) {
+				float ssim_row = 0.0f;
+				float cs_row = 0.0f;
+				switch (terms) {
+				case SSIM_MEAN:
+					sumMaps<true, false>(m1, h2, m11, h22, h12, c, out_len, cn, c1, c2, ssim_row, cs_row);
+					break;
+				case CS_MEAN:
+					sumMaps<false, true>(m1, h2, m11, h22, h12, c, out_len, cn, c1, c2, ssim_row, cs_row);
+					break;
+				default:
+					sumMaps<true, true>(m1, h2, m11, h22, h12, c, out_len, cn, c1, c2, ssim_row, cs_row);
+					break;
+				}
+				ssim_sum[c] += static_cast<double>(ssim_row);
+				cs_sum[c] += static_cast<double>(cs_row);
+			}
+		}
+	}
+}
 
-	return res;
+std::vector<cv::Mat>& SSIM::prepareLines(Workspace& ws, int cn) const
+{
+	const int cols = (TILE_SIZE + GK_SIZE - 1) * cn;
+	std::vector<cv::Mat>& lines = ws.state<State>(this).lines;
+	lines.resize(static_cast<size_t>(workerCount(ws)));
+	for (size_t w = 0; w < lines.size(); w++) {
+		lines[w].create(10, cols, CV_32F);
+	}
+	return lines;
 }
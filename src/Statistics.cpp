@@ -0,0 +1,172 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "Statistics.hpp"
+
+namespace {
+	// Number of values buffered before being merged into the centroids
+	const size_t BUFFER_SIZE = 5 * Statistics::COMPRESSION;
+}
+
+Statistics::Statistics() : n(0), avg(0), m2(0), min(0), max(0)
+{
+}
+
+void Statistics::add(double value)
+{
+	n++;
+	double delta = value - avg;
+	avg += delta / static_cast<double>(n);
+	m2 += delta * (value - avg);
+	min = n == 1 ? value : std::min(min, value);
+	max = n == 1 ? value : std::max(max, value);
+
+	Centroid c = {value, 1};
+	buffer.push_back(c);
+	if (buffer.size() >= BUFFER_SIZE) {
+		compress();
+	}
+}
+
+void Statistics::merge(const Statistics& other)
+{
+	if (other.n == 0) {
+		return;
+	}
+	if (n == 0) {
+		*this = other;
+		return;
+	}
+
+	// Chan et al. update of the mean and of the squared differences
+	double na = static_cast<double>(n);
+	double nb = static_cast<double>(other.n);
+	double delta = other.avg - avg;
+	n += other.n;
+	avg += delta * nb / (na + nb);
+	m2 += other.m2 + delta * delta * na * nb / (na + nb);
+	min = std::min(min, other.min);
+	max = std::max(max, other.max);
+
+	buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+	buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+	if (buffer.size() >= BUFFER_SIZE) {
+		compress();
+	}
+}
+
+size_t Statistics::count() const
+{
+	return n;
+}
+
+double Statistics::mean() const
+{
+	return avg;
+}
+
+double Statistics::stddev() const
+{
+	return n < 2 ? 0 : sqrt(m2 / static_cast<double>(n - 1));
+}
+
+double Statistics::quantile(double q) const
+{
+	if (n == 0) {
+		return 0;
+	}
+	std::vector<Centroid> merged;
+	const std::vector<Centroid> *digest = &centroids;
+	if (!buffer.empty()) {
+		merged = centroids;
+		merged.insert(merged.end(), buffer.begin(), buffer.end());
+		compress(merged, static_cast<double>(n));
+		digest = &merged;
+	}
+
+	// Each centroid stands at the middle of the ranks of its values, from 0,
+	// the minimum and the maximum at the first and last ranks
+	double rank = q * static_cast<double>(n - 1);
+	double before = 0;
+	double position = 0;
+	double value = min;
+	for (size_t i = 0; i < digest->size(); i++) {
+		const Centroid& c = (*digest)[i];
+		double next = before + (c.weight - 1) / 2;
+		if (rank <= next) {
+			if (next <= position) {
+				return c.mean;
+			}
+			return value + (c.mean - value) * (rank - position) / (next - position);
+		}
+		position = next;
+		value = c.mean;
+		before += c.weight;
+	}
+	double last = static_cast<double>(n - 1);
+	if (last <= position) {
+		return value;
+	}
+	return value + (max - value) * (rank - position) / (last - position);
+}
+
+void Statistics::compress()
+{
+	buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+	compress(buffer, static_cast<double>(n));
+	centroids.swap(buffer);
+	buffer.clear();
+}
+
+// Sort the centroids and merge the neighbouring ones while the weight of the
+// result stays below 4*total*q*(1-q)/COMPRESSION, q being its quantile, so
+// that the centroids are the smallest at the tails
+void Statistics::compress(std::vector<Centroid>& digest, double total)
+{
+	if (digest.empty()) {
+		return;
+	}
+	std::sort(digest.begin(), digest.end(), [](const Centroid& a, const Centroid& b) {
+		return a.mean < b.mean;
+	});
+
+	size_t last = 0;
+	double before = 0;
+	for (size_t i = 1; i < digest.size(); i++) {
+		Centroid& current = digest[last];
+		double weight = current.weight + digest[i].weight;
+		double q = (before + weight / 2) / total;
+		if (weight <= 4 * total * q * (1 - q) / COMPRESSION) {
+			current.mean += (digest[i].mean - current.mean) * digest[i].weight / weight;
+			current.weight = weight;
+		}
+		else {
+			before += current.weight;
+			digest[++last] = digest[i];
+		}
+	}
+	digest.resize(last + 1);
+}
@@ -0,0 +1,158 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include "ThreadPool.hpp"
+
+namespace {
+	// Index of the worker running on the current thread, -1 outside loops
+	thread_local int current_worker = -1;
+}
+
+ThreadPool::ThreadPool(int n) :
+  nbthreads(n < 1 ? 1 : n), task(nullptr), generation(0), pending(0), stop(false)
+{
+	ranges = new Range[nbthreads];
+	for (int w = 1; w < nbthreads; w++) {
+		threads.push_back(std::thread(&ThreadPool::run, this, w));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+	}
+	start.notify_all();
+	for (size_t t = 0; t < threads.size(); t++) {
+		threads[t].join();
+	}
+	delete[] ranges;
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int, int)>& f)
+{
+	// Nested loops and single-threaded pools run on the calling thread
+	if (current_worker >= 0 || nbthreads == 1) {
+		int worker = current_worker >= 0 ? current_worker : 0;
+		for (int i = 0; i < n; i++) {
+			f(worker, i);
+		}
+		return;
+	}
+
+	for (int w = 0; w < nbthreads; w++) {
+		std::lock_guard<std::mutex> guard(ranges[w].lock);
+		ranges[w].begin = static_cast<int>(static_cast<long long>(n) * w / nbthreads);
+		ranges[w].end = static_cast<int>(static_cast<long long>(n) * (w + 1) / nbthreads);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		task = &f;
+		pending = nbthreads - 1;
+		generation++;
+	}
+	start.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> guard(lock);
+	while (pending > 0) {
+		done.wait(guard);
+	}
+	task = nullptr;
+}
+
+void ThreadPool::run(int worker)
+{
+	unsigned seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (!stop && generation == seen) {
+				start.wait(guard);
+			}
+			if (stop) {
+				return;
+			}
+			seen = generation;
+		}
+
+		work(worker);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			pending--;
+		}
+		done.notify_one();
+	}
+}
+
+void ThreadPool::work(int worker)
+{
+	current_worker = worker;
+	int index;
+	while (pop(worker, index) || steal(worker, index)) {
+		(*task)(worker, index);
+	}
+	current_worker = -1;
+}
+
+bool ThreadPool::pop(int worker, int& index)
+{
+	Range& r = ranges[worker];
+	std::lock_guard<std::mutex> guard(r.lock);
+	if (r.begin >= r.end) {
+		return false;
+	}
+	index = r.begin++;
+	return true;
+}
+
+bool ThreadPool::steal(int worker, int& index)
+{
+	for (int i = 1; i < nbthreads; i++) {
+		Range& victim = ranges[(worker + i) % nbthreads];
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> guard(victim.lock);
+			if (victim.begin >= victim.end) {
+				continue;
+			}
+			// Take the upper half, the victim keeps working on the lower one
+			begin = victim.begin + (victim.end - victim.begin) / 2;
+			end = victim.end;
+			victim.end = begin;
+		}
+
+		Range& own = ranges[worker];
+		std::lock_guard<std::mutex> guard(own.lock);
+		own.begin = begin + 1;
+		own.end = end;
+		index = begin;
+		return true;
+	}
+	return false;
+}
@@ -45,165 +45,219 @@
 //   Image Processing, vol. 15, no. 2, pp. 430-444, February 2006.
 //
 
+#include <algorithm>
+#include <vector>
 #include "VIFP.hpp"
+#include "Kernels.hpp"
 
 const float VIFP::SIGMA_NSQ = 2.0f;
 
-VIFP::VIFP(int h, int w) : Metric(h, w),
-    tmp1(h, w, CV_32F),
-    tmp2(h, w, CV_32F),
-    tmp(h, w, CV_32F),
-    mu1(h, w, CV_32F),
-    mu2(h, w, CV_32F),
-    mu1_sq(h, w, CV_32F),
-    mu2_sq(h, w, CV_32F),
-    mu1_mu2(h, w, CV_32F),
-    sigma1_sq(h, w, CV_32F),
-    sigma2_sq(h, w, CV_32F),
-    sigma12(h, w, CV_32F),
-    g(h, w, CV_32F),
-    sv_sq(h, w, CV_32F),
-    sigma1_sq_th(h, w, CV_32F),
-    sigma2_sq_th(h, w, CV_32F),
-    g_th(h, w, CV_32F)
+struct VIFP::State : Workspace::State {
+	// The first scale refers to the input images
+	cv::Mat ref[NLEVS];
+	cv::Mat dist[NLEVS];
+	// Filtered ref and ref^2 of each scale
+	cv::Mat ref_mu[NLEVS];
+	cv::Mat ref_sq[NLEVS];
+	// Line buffers of the pyramids
+	LineBuffers lines;
+	// Buffers of the bands computed by one worker, those of the current
+	// frame being taken from the arena of the workspace
+	struct BandBuffers {
+		LineBuffers lines;
+		// x^2 and xy of the input rows of the largest band
+		cv::Mat dist_sq, ref_dist;
+	};
+	std::vector<BandBuffers> bands;
+};
+
+VIFP::VIFP(int h, int w, int bitdepth) : Metric(h, w, CV_32F, bitdepth)
 {
 	for (int scale=0; scale<NLEVS; scale++) {
-		ref[scale] = cv::Mat(h, w, CV_32F);
-		dist[scale] = cv::Mat(h, w, CV_32F);
+		// N=2^(4-scale+1)+1;
+		int N = (2 << (NLEVS-scale-1)) + 1;
+		// win=fspecial('gaussian',N,N/5);
+		window[scale] = cv::getGaussianKernel(N, N/5.0, CV_32F);
+	}
+}
+
+float VIFP::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const
+{
+	setReference(original, ws);
+	return compute(processed, ws);
+}
 
+void VIFP::setReference(const cv::Mat& original, Workspace& ws) const
+{
+	State& st = ws.state<State>(this);
+	FeatureCache *cache = ws.getCache();
+	Arena& arena = ws.getArena();
+	cv::Mat *ref = st.ref;
+	cv::Mat *ref_mu = st.ref_mu;
+	cv::Mat *ref_sq = st.ref_sq;
+
+	// for scale=1:4
+	for (int scale=0; scale<NLEVS; scale++) {
 		// N=2^(4-scale+1)+1;
 		int N = (2 << (NLEVS-scale-1)) + 1;
+		
+		if (scale == 0) {
+			ref[scale] = original;
+		}
+		else {
+			// ref=filter2(win,ref,'valid');
+			// ref=ref(1:2:end,1:2:end);
+			// (only the kept samples are filtered)
+			applyGaussianDecimate(ref[scale-1], ref[scale], window[scale], st.lines);
+		}
 
-		w = (w-(N-1)) / 2;
-		h = (h-(N-1)) / 2;
+		// The moments of the original frame are shared through the cache
+		cv::Mat *mu = &ref_mu[scale];
+		cv::Mat *sq = &ref_sq[scale];
+		if (scale == 0 && cache != nullptr && cache->moments(original, N, N/5.0, mu, sq)) {
+			ref_mu[scale] = *mu;
+			ref_sq[scale] = *sq;
+			continue;
+		}
+
+		// mu1 = filter2(win, ref, 'valid');
+		applyGaussianBlur(ref[scale], *mu, window[scale], st.lines);
+		// filter2(win, ref.*ref, 'valid')
+		if (scale == 0 && cache != nullptr) {
+			applyGaussianBlur(cache->product(original, original), *sq, window[scale], st.lines);
+		}
+		else {
+			cv::Mat tmp = arena.mat(ref[scale].rows, ref[scale].cols, CV_32F);
+			cv::multiply(ref[scale], ref[scale], tmp);
+			applyGaussianBlur(tmp, *sq, window[scale], st.lines);
+		}
+		ref_mu[scale] = *mu;
+		ref_sq[scale] = *sq;
 	}
 }
 
-float VIFP::compute(const cv::Mat& original, const cv::Mat& processed)
+float VIFP::compute(const cv::Mat& processed, Workspace& ws) const
 {
+	State& st = ws.state<State>(this);
+	cv::Mat *dist = st.dist;
 	double num = 0.0;
 	double den = 0.0;
-	
-	int w = width;
-	int h = height;
-	
+
 	// for scale=1:4
 	for (int scale=0; scale<NLEVS; scale++) {
 		// N=2^(4-scale+1)+1;
 		int N = (2 << (NLEVS-scale-1)) + 1;
 		
 		if (scale == 0) {
-			original.copyTo(ref[scale]);
-			processed.copyTo(dist[scale]);
+			dist[scale] = processed;
 		}
 		else {
-			// ref=filter2(win,ref,'valid');
-			applyGaussianBlur(ref[scale-1], tmp1, N, N/5.0);
 			// dist=filter2(win,dist,'valid');
-			applyGaussianBlur(dist[scale-1], tmp2, N, N/5.0);
-			
-			w = (w-(N-1)) / 2;
-			h = (h-(N-1)) / 2;
-			
-			// ref=ref(1:2:end,1:2:end);
-			cv::resize(tmp1, ref[scale], cv::Size(w,h), 0, 0, cv::INTER_NEAREST);
 			// dist=dist(1:2:end,1:2:end);
-			cv::resize(tmp2, dist[scale], cv::Size(w,h), 0, 0, cv::INTER_NEAREST);
+			applyGaussianDecimate(dist[scale-1], dist[scale], window[scale], st.lines);
 		}
 		
-		computeVIFP(ref[scale], dist[scale], N, num, den);
+		computeVIFP(st, scale, N, num, den, ws);
 	}
 	
 	return float(num/den);
 }
 
-void VIFP::computeVIFP(const cv::Mat& ref_, const cv::Mat& dist_, int N, double& num, double& den)
+void VIFP::computeVIFP(State& st, int scale, int N, double& num, double& den, Workspace& ws) const
 {
-	// mu1 = filter2(win, ref_, 'valid');
-	applyGaussianBlur(ref_, mu1, N, N/5.0);
-	// mu2 = filter2(win, dist_, 'valid');
-	applyGaussianBlur(dist_, mu2, N, N/5.0);
-	
-	const float EPSILON = 1e-10f;
-
-	// mu1_sq = mu1.*mu1;
-	cv::multiply(mu1, mu1, mu1_sq);
-	// mu2_sq = mu2.*mu2;
-	cv::multiply(mu2, mu2, mu2_sq);
-	// mu1_mu2 = mu1.*mu2;
-	cv::multiply(mu1, mu2, mu1_mu2);		
-	
-	// sigma1_sq = filter2(win, ref_.*ref_, 'valid') - mu1_sq;
-	cv::multiply(ref_, ref_, tmp);
-	applyGaussianBlur(tmp, sigma1_sq, N, N/5.0);
-	sigma1_sq -= mu1_sq;
-	// sigma2_sq = filter2(win, dist_.*dist_, 'valid') - mu2_sq;
-	cv::multiply(dist_, dist_, tmp);
-	applyGaussianBlur(tmp, sigma2_sq, N, N/5.0);
-	sigma2_sq -= mu2_sq;
-	// sigma12 = filter2(win, ref_.*dist_, 'valid') - mu1_mu2;
-	cv::multiply(ref_, dist_, tmp);
-	applyGaussianBlur(tmp, sigma12, N, N/5.0);
-	sigma12 -= mu1_mu2;
-	
-	// sigma1_sq(sigma1_sq<0)=0;
-	cv::max(sigma1_sq, 0.0f, sigma1_sq);
-	// sigma2_sq(sigma2_sq<0)=0;
-	cv::max(sigma2_sq, 0.0f, sigma2_sq);
-	
-	// g=sigma12./(sigma1_sq+1e-10);
-	tmp = sigma1_sq + EPSILON;
-	cv::divide(sigma12, tmp, g);
-	
-	// sv_sq=sigma2_sq-g.*sigma12;
-	cv::multiply(g, sigma12, tmp);
-	sv_sq = sigma2_sq - tmp;
-	
-	cv::threshold(sigma1_sq, sigma1_sq_th, EPSILON, 1.0f, cv::THRESH_BINARY);
+	FeatureCache *cache = ws.getCache();
+	const cv::Mat& ref_ = st.ref[scale];
+	const cv::Mat& dist_ = st.dist[scale];
+	const cv::Mat& mu1 = st.ref_mu[scale];
+	const cv::Mat& sq1 = st.ref_sq[scale];
+	const int out_rows = mu1.rows;
 
-	// g(sigma1_sq<1e-10)=0;
-	cv::multiply(g, sigma1_sq_th, g);
-	
-	// sv_sq(sigma1_sq<1e-10)=sigma2_sq(sigma1_sq<1e-10);
-	cv::multiply(sv_sq, sigma1_sq_th, sv_sq);
-	cv::multiply(sigma2_sq, 1.0f - sigma1_sq_th, tmp);
-	sv_sq += tmp;
-	
-	// sigma1_sq(sigma1_sq<1e-10)=0;
-	cv::threshold(sigma1_sq, sigma1_sq, EPSILON, 1.0f, cv::THRESH_TOZERO);
-	
-	cv::threshold(sigma2_sq, sigma2_sq_th, EPSILON, 1.0f, cv::THRESH_BINARY);
+	// The products of the first scale come from the cache, which is only
+	// used outside of the bands
+	const cv::Mat *dist_sq = nullptr;
+	const cv::Mat *ref_dist = nullptr;
+	if (scale == 0 && cache != nullptr) {
+		dist_sq = &cache->product(dist_, dist_);
+		ref_dist = &cache->product(ref_, dist_);
+	}
+
+	// Each band of output rows [y0, y1) is filtered from the input rows
+	// [y0, y1+N-1), i.e. with (N-1)/2 halo rows on each side
+	// The buffers of the bands are taken from the arena beforehand, which
+	// is not thread-safe, and the line buffers of each worker are sized for
+	// the bands of this scale whichever it computes
+	const int nbands = bandCount(out_rows);
+	Arena& arena = ws.getArena();
+	double *sums = arena.allocate<double>(static_cast<size_t>(nbands) * 2);
+	st.bands.resize(static_cast<size_t>(workerCount(ws)));
+	for (size_t w = 0; w < st.bands.size(); w++) {
+		State::BandBuffers& buf = st.bands[w];
+		reserveLines(buf.lines, 3, dist_.cols, 1, N);
+		if (dist_sq == nullptr) {
+			const int in_rows = std::min(out_rows, static_cast<int>(BAND_ROWS)) + N - 1;
+			buf.dist_sq = arena.mat(in_rows, dist_.cols, CV_32F);
+			buf.ref_dist = arena.mat(in_rows, dist_.cols, CV_32F);
+		}
+	}
+
+	forEachBand(ws, nbands, [&](int worker, int band) {
+		State::BandBuffers& buf = st.bands[static_cast<size_t>(worker)];
+		const int y0 = band * BAND_ROWS;
+		const int y1 = std::min(out_rows, y0 + BAND_ROWS);
+		cv::Mat src[3];
+		src[0] = dist_;
+		if (dist_sq != nullptr) {
+			src[1] = *dist_sq;
+			src[2] = *ref_dist;
+		}
+		else {
+			// Products of the input rows of the band only
+			const cv::Range in(y0, y1 + N - 1);
+			src[0] = dist_.rowRange(in.start, in.end);
+			src[1] = buf.dist_sq.rowRange(0, in.size());
+			src[2] = buf.ref_dist.rowRange(0, in.size());
+			cv::multiply(src[0], src[0], src[1]);
+			cv::multiply(ref_.rowRange(in.start, in.end), src[0], src[2]);
+		}
+		// Offset of the band in the source images
+		const int offset = dist_sq != nullptr ? 0 : y0;
+
+		double band_num = 0.0;
+		double band_den = 0.0;
+
+		// mu2 = filter2(win, dist_, 'valid');
+		// sigma1_sq = filter2(win, ref_.*ref_, 'valid') - mu1_sq;
+		// sigma2_sq = filter2(win, dist_.*dist_, 'valid') - mu2_sq;
+		// sigma12 = filter2(win, ref_.*dist_, 'valid') - mu1_mu2;
+		// (the local second moments only, the kernel subtracts the squared means;
+		// those of the reference come from setReference())
+		filterRows(src, 3, window[scale].ptr<float>(0), N, y0 - offset, y1 - offset, buf.lines,
+			[&](int y, int x0, int n, const float* const* rows) {
+			const int yy = y + offset;
+
+			// Clamping and thresholding of sigma1_sq, sigma2_sq, g and sv_sq, then
+			// sums of log(1+g.^2.*sigma1_sq./(sv_sq+sigma_nsq)) and
+			// log(1+sigma1_sq./sigma_nsq), in registers
+			Kernels::vifLogSums(mu1.ptr<float>(yy) + x0, rows[0],
+				sq1.ptr<float>(yy) + x0, rows[1], rows[2],
+				SIGMA_NSQ * range_sq, n, band_num, band_den);
+		});
+
+		sums[static_cast<size_t>(band) * 2] = band_num;
+		sums[static_cast<size_t>(band) * 2 + 1] = band_den;
+	});
+
+	// The sums of the bands are added in order
+	double num_sum = 0.0;
+	double den_sum = 0.0;
+	for (int band = 0; band < nbands; band++) {
+		num_sum += sums[static_cast<size_t>(band) * 2];
+		den_sum += sums[static_cast<size_t>(band) * 2 + 1];
+	}
 
-	// g(sigma2_sq<1e-10)=0;
-	cv::multiply(g, sigma2_sq_th, g);
-	
-	// sv_sq(sigma2_sq<1e-10)=0;
-	cv::multiply(sv_sq, sigma2_sq_th, sv_sq);
-	
-	cv::threshold(g, g_th, 0.0f, 1.0f, cv::THRESH_BINARY);
-	
-	// sv_sq(g<0)=sigma2_sq(g<0);
-	cv::multiply(sv_sq, g_th, sv_sq);
-	cv::multiply(sigma2_sq, 1.0f - g_th, tmp);
-	cv::add(sv_sq, tmp, sv_sq);
-	
-	// g(g<0)=0;
-	cv::max(g, 0.0f, g);
-	
-	// sv_sq(sv_sq<=1e-10)=1e-10;
-	cv::max(sv_sq, EPSILON, sv_sq);
-	
 	// num=num+sum(sum(log10(1+g.^2.*sigma1_sq./(sv_sq+sigma_nsq))));
-	sv_sq += SIGMA_NSQ;
-	cv::multiply(g, g, g);
-	cv::multiply(g, sigma1_sq, g);
-	cv::divide(g, sv_sq, tmp);
-	tmp += 1.0f;
-	cv::log(tmp, tmp);
-	num += cv::sum(tmp)[0] / log(10.0f);
-	
+	num += num_sum / log(10.0f);
+
 	// den=den+sum(sum(log10(1+sigma1_sq./sigma_nsq)));
-	tmp = 1.0f + sigma1_sq / SIGMA_NSQ;
-	cv::log(tmp, tmp);
-	den += cv::sum(tmp)[0] / log(10.0f);
+	den += den_sum / log(10.0f);
 }
@@ -22,11 +22,159 @@
 // maintenance, support, updates, enhancements, or modifications.
 //
 
+#include <algorithm>
+#include <cerrno>
 #include "VideoYUV.hpp"
 
-VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format)
+namespace {
+	// Set the position of a file which may be larger than 2GB
+	int seek64(FILE *f, long long offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(f, offset, SEEK_SET);
+#else
+		return fseeko(f, static_cast<off_t>(offset), SEEK_SET);
+#endif
+	}
+
+	// Signature at the start of Y4M streams
+	const char Y4M_SIGNATURE[] = "YUV4MPEG2 ";
+	const size_t Y4M_SIGNATURE_SIZE = sizeof(Y4M_SIGNATURE) - 1;
+	// Marker at the start of each Y4M frame, possibly followed by parameters
+	const char Y4M_FRAME[] = "FRAME";
+	const size_t Y4M_FRAME_SIZE = sizeof(Y4M_FRAME) - 1;
+	// Longest header line accepted
+	const size_t Y4M_MAX_LINE = 1024;
+
+	// Whether the host stores integers from their most significant byte,
+	// the samples above 8 bits being read as little-endian unsigned shorts
+	const bool BIG_ENDIAN_HOST =
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		true;
+#else
+		false;
+#endif
+
+	// Swap the two bytes of the n samples of src into dst, which may be src
+	void swapBytes(imgpel *dst, const imgpel *src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			const imgpel lo = src[2*i];
+			dst[2*i] = src[2*i+1];
+			dst[2*i+1] = lo;
+		}
+	}
+
+	// Parse the 'C' parameter of a Y4M stream header, e.g. 420jpeg,
+	// 422, 444p10 or mono12
+	bool parseY4MColorspace(const std::string& cs, int& chroma_format, int& bd)
+	{
+		static const struct {
+			const char *name;
+			int format;
+		} FORMATS[] = {
+			{"420", CHROMA_SUBSAMP_420},
+			{"422", CHROMA_SUBSAMP_422},
+			{"444", CHROMA_SUBSAMP_444},
+			{"mono", CHROMA_SUBSAMP_400}
+		};
+
+		for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); i++) {
+			size_t len = strlen(FORMATS[i].name);
+			if (cs.compare(0, len, FORMATS[i].name) != 0) {
+				continue;
+			}
+
+			std::string rest = cs.substr(len);
+			chroma_format = FORMATS[i].format;
+			bd = 8;
+			// Chroma siting variants of 4:2:0, irrelevant for the metrics
+			if (rest.empty() || rest == "jpeg" || rest == "paldv" || rest == "mpeg2") {
+				return true;
+			}
+			// Bit depth, e.g. 420p10 or mono10
+			if (rest[0] == 'p') {
+				rest = rest.substr(1);
+			}
+			if (rest.empty() || rest.find_first_not_of("0123456789") != std::string::npos) {
+				return false;
+			}
+			bd = atoi(rest.c_str());
+			return bd >= 8 && bd <= 16;
+		}
+
+		return false;
+	}
+
+	// Interleave the planes of a frame into YUV 4:4:4 (Y, U, V per pixel),
+	// upsampling the chroma planes by sample repetition
+	template<typename T>
+	void interleave(T *yuv, const T *lptr, const T *c0, const T *c1, int height, int width, int chf)
+	{
+		T *ptr = yuv;
+
+		if (chf == CHROMA_SUBSAMP_400) {
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					*ptr++ = *lptr++;
+					*ptr++ = 0;
+					*ptr++ = 0;
+				}
+			}
+		} else if (chf == CHROMA_SUBSAMP_420) {
+			T *next_line_ptr = yuv + width * 3;
+			const T *next_line_lptr = lptr + width;
+
+			for (int y = 0; y < height; y += 2) {
+				for (int x = 0; x < width; x += 2) {
+					*ptr++ = *lptr++;
+					*ptr++ = *c0;
+					*ptr++ = *c1;
+
+					*ptr++ = *lptr++;
+					*ptr++ = *c0;
+					*ptr++ = *c1;
+
+					*next_line_ptr++ = *next_line_lptr++;
+					*next_line_ptr++ = *c0;
+					*next_line_ptr++ = *c1;
+
+					*next_line_ptr++ = *next_line_lptr++;
+					*next_line_ptr++ = *c0++;
+					*next_line_ptr++ = *c1++;
+				}
+
+				ptr += width * 3;
+				lptr += width;
+				next_line_ptr += width * 3;
+				next_line_lptr += width;
+			}
+		} else if (chf == CHROMA_SUBSAMP_422) {
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; x += 2) {
+					*ptr++ = *lptr++;
+					*ptr++ = *c0;
+					*ptr++ = *c1;
+
+					*ptr++ = *lptr++;
+					*ptr++ = *c0++;
+					*ptr++ = *c1++;
+				}
+			}
+		} else if (chf == CHROMA_SUBSAMP_444) {
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					*ptr++ = *lptr++;
+					*ptr++ = *c0++;
+					*ptr++ = *c1++;
+				}
+			}
+		}
+	}
+}
+
+VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format, int bd)
 {
-	chf = chroma_format;
 	if(strcmp(f, "-") == 0)
 		file = stdin;
 	else
@@ -36,6 +184,49 @@ VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format)
 		fprintf(stderr, "readOneFrame: cannot open input file (%s)\n", f);
 		exit(EXIT_FAILURE);
 	}
+
+	// Y4M streams start with a signature followed by the stream header,
+	// the geometry given by the caller is then only checked
+	y4m = false;
+	header_size = 0;
+	char signature[Y4M_SIGNATURE_SIZE];
+	size_t nbread = fread(signature, 1, Y4M_SIGNATURE_SIZE, file);
+	if (nbread == Y4M_SIGNATURE_SIZE && memcmp(signature, Y4M_SIGNATURE, Y4M_SIGNATURE_SIZE) == 0) {
+		std::string header;
+		int y4m_h, y4m_w;
+		if (!readLine(header) || !parseY4MHeader(header, y4m_h, y4m_w, chroma_format, bd)) {
+			fprintf(stderr, "VideoYUV: invalid or unsupported Y4M stream header in input file (%s)\n", f);
+			exit(EXIT_FAILURE);
+		}
+		if ((h != 0 && h != y4m_h) || (w != 0 && w != y4m_w)) {
+			fprintf(stderr, "VideoYUV: the size of the video (%dx%d) does not match the Y4M stream header of input file %s (%dx%d)\n", w, h, f, y4m_w, y4m_h);
+			exit(EXIT_FAILURE);
+		}
+		h = y4m_h;
+		w = y4m_w;
+		y4m = true;
+		header_size = Y4M_SIGNATURE_SIZE + header.size() + 1;
+	}
+
+	// Go back to the first frame, unless the input cannot be repositioned:
+	// the bytes read are then the start of the first raw frame
+	seekable = file != stdin && seek64(file, static_cast<long long>(header_size)) == 0;
+	if (!seekable && !y4m) {
+		peeked.assign(signature, nbread);
+	}
+
+	if (h <= 0 || w <= 0) {
+		fprintf(stderr, "VideoYUV: 'height' and 'width' are required for raw YUV input file (%s)\n", f);
+		exit(EXIT_FAILURE);
+	}
+
+	chf = chroma_format;
+	if (bd < 8 || bd > 16) {
+		fprintf(stderr, "VideoYUV: unsupported bit depth %d, it has to be between 8 and 16.\n", bd);
+		exit(EXIT_FAILURE);
+	}
+	bitdepth = bd;
+	bps = bitdepth > 8 ? 2 : 1;
 	height = h;
 	width  = w;
 	nbframes = nbf;
@@ -74,99 +265,411 @@ VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format)
 	comp_size[1] = comp_height[1]*comp_width[1];
 	comp_size[2] = comp_height[2]*comp_width[2];
 	
-	size = static_cast<size_t>(comp_size[0]+comp_size[1]+comp_size[2]);
+	size = static_cast<size_t>(comp_size[0]+comp_size[1]+comp_size[2]) * static_cast<size_t>(bps);
 	
-	data = new imgpel[size];
-	luma = data;
-	chroma[0] = data+comp_size[0];
-	chroma[1] = data+comp_size[0]+comp_size[1];
-	yuv_data = new imgpel[height * width * 3];
+	map = nullptr;
+	map_size = 0;
+	nbmapped = 0;
+	frame_no = 0;
+	eof = false;
+	ring = nullptr;
+	reader = nullptr;
+	frame_held = false;
+
+	// Regular files are mapped in memory: frames are then accessed in place
+	// and the fread() into 'data' is not needed
+	if (file != stdin && mapFile()) {
+		data = nullptr;
+		setFrame(map);
+	}
+	else {
+		if (y4m && seekable) {
+			indexFile();
+		}
+		enlargePipe();
+		data = new imgpel[size];
+		setFrame(data);
+	}
+	yuv_data = new imgpel[static_cast<size_t>(height * width * 3 * bps)];
 }
 
 VideoYUV::~VideoYUV()
 {
+	if (reader) {
+		ring->close();
+		reader->join();
+		delete reader;
+		delete ring;
+	}
+#ifndef _WIN32
+	if (map) {
+		munmap(map, map_size);
+	}
+#endif
 	delete[] data;
+	delete[] yuv_data;
 	fclose(file);
 }
 
-bool VideoYUV::readOneFrame()
+bool VideoYUV::mapFile()
 {
-	imgpel *ptr_data = data;
+#ifndef _WIN32
+	struct stat st;
+	if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < static_cast<off_t>(size)) {
+		return false;
+	}
 
-	if (fread(ptr_data, 1, size, file) != size) {
-		fprintf(stderr, "readOneFrame: cannot read %zu bytes from input file, unexpected EOF.\n", size);
-    return false;
-  }
-	yuv_ready = false;
+	map_size = static_cast<size_t>(st.st_size);
+	void *ptr = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (ptr == MAP_FAILED) {
+		map_size = 0;
+		return false;
+	}
+	map = static_cast<imgpel*>(ptr);
+	if (y4m) {
+		indexMapped();
+		nbmapped = static_cast<int>(offsets.size());
+	}
+	else {
+		nbmapped = static_cast<int>(map_size / size);
+	}
+
+	// Frames are mostly accessed in order: let the kernel read ahead
+	// aggressively and drop pages behind us
+	madvise(ptr, map_size, MADV_SEQUENTIAL);
 
 	return true;
+#else
+	return false;
+#endif
 }
 
-imgpel *VideoYUV::getYUV()
+void VideoYUV::enlargePipe()
 {
-	if (yuv_ready) return yuv_data;
+#ifdef F_SETPIPE_SZ
+	// The default 64kB buffer of a pipe holds a fraction of a frame, the
+	// writer (e.g. a decoder) then blocks until the frame is read. Ask for
+	// a buffer of at least two frames, or the largest one allowed to
+	// unprivileged processes.
+	struct stat st;
+	int fd = fileno(file);
+	if (fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode)) {
+		return;
+	}
+	long wanted = static_cast<long>(std::min(2 * size, static_cast<size_t>(1) << 30));
+	if (fcntl(fd, F_GETPIPE_SZ) >= wanted || fcntl(fd, F_SETPIPE_SZ, wanted) >= 0) {
+		return;
+	}
+	FILE *max_file = fopen("/proc/sys/fs/pipe-max-size", "r");
+	if (max_file) {
+		long max_size = 0;
+		if (fscanf(max_file, "%ld", &max_size) == 1 && max_size > fcntl(fd, F_GETPIPE_SZ)) {
+			fcntl(fd, F_SETPIPE_SZ, max_size);
+		}
+		fclose(max_file);
+	}
+#endif
+}
 
-	imgpel *ptr = yuv_data;
-	imgpel *lptr = luma;
-	imgpel *c0 = chroma[0];
-	imgpel *c1 = chroma[1];
-
-	if (chf == CHROMA_SUBSAMP_400) {
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				*ptr++ = *lptr++;
-				*ptr++ = 0;
-				*ptr++ = 0;
+bool VideoYUV::parseY4MHeader(const std::string& header, int& h, int& w, int& chroma_format, int& bd)
+{
+	h = 0;
+	w = 0;
+	chroma_format = CHROMA_SUBSAMP_420;
+	bd = 8;
+
+	// Parameters are separated by spaces and start with a letter
+	size_t pos = 0;
+	while (pos < header.size()) {
+		size_t end = header.find(' ', pos);
+		if (end == std::string::npos) {
+			end = header.size();
+		}
+		std::string param = header.substr(pos, end - pos);
+		pos = end + 1;
+		if (param.empty()) {
+			continue;
+		}
+
+		switch (param[0]) {
+		case 'W':
+			w = atoi(param.c_str() + 1);
+			break;
+		case 'H':
+			h = atoi(param.c_str() + 1);
+			break;
+		case 'C':
+			if (!parseY4MColorspace(param.substr(1), chroma_format, bd)) {
+				return false;
 			}
+			break;
+		default:
+			// Frame rate, interlacing, aspect ratio and extensions are not
+			// needed by the metrics
+			break;
 		}
-	} else if (chf == CHROMA_SUBSAMP_420) {
-		imgpel *next_line_ptr = yuv_data + width * 3;
-		imgpel *next_line_lptr = luma + width;
+	}
 
-		for (int y = 0; y < height; y += 2) {
-			for (int x = 0; x < width; x += 2) {
-				*ptr++ = *lptr++;
-				*ptr++ = *c0;
-				*ptr++ = *c1;
+	return h > 0 && w > 0;
+}
+
+bool VideoYUV::readLine(std::string& line)
+{
+	line.clear();
+	int c;
+	while ((c = getc(file)) != EOF && c != '\n') {
+		if (line.size() >= Y4M_MAX_LINE) {
+			return false;
+		}
+		line.push_back(static_cast<char>(c));
+	}
 
-				*ptr++ = *lptr++;
-				*ptr++ = *c0;
-				*ptr++ = *c1;
+	return c == '\n';
+}
+
+bool VideoYUV::readFrameHeader()
+{
+	std::string line;
+	if (!readLine(line)) {
+		eof = line.empty() && feof(file);
+		return false;
+	}
+	return line.compare(0, Y4M_FRAME_SIZE, Y4M_FRAME) == 0;
+}
 
-				*next_line_ptr++ = *next_line_lptr++;
-				*next_line_ptr++ = *c0;
-				*next_line_ptr++ = *c1;
+size_t VideoYUV::readInput(imgpel *dst, size_t n)
+{
+	size_t done = 0;
+	if (!peeked.empty()) {
+		done = std::min(n, peeked.size());
+		memcpy(dst, peeked.data(), done);
+		peeked.erase(0, done);
+	}
 
-				*next_line_ptr++ = *next_line_lptr++;
-				*next_line_ptr++ = *c0++;
-				*next_line_ptr++ = *c1++;
+	// A read from a pipe returns what the writer has written so far: go on
+	// until the frame is complete, or the end of the input
+	while (done < n) {
+		size_t nbread = fread(dst + done, 1, n - done, file);
+		done += nbread;
+		if (nbread == 0) {
+			if (!ferror(file) || errno != EINTR) {
+				break;
 			}
+			clearerr(file);
+		}
+	}
+	// Nothing left at the start of a raw frame: clean end of the input
+	eof = done == 0 && !y4m;
+
+	return done;
+}
+
+void VideoYUV::indexMapped()
+{
+	size_t pos = header_size;
+	while (pos + Y4M_FRAME_SIZE <= map_size && memcmp(map + pos, Y4M_FRAME, Y4M_FRAME_SIZE) == 0) {
+		const void *eol = memchr(map + pos, '\n', std::min(map_size - pos, Y4M_MAX_LINE));
+		if (!eol) {
+			break;
+		}
+		size_t frame_data = static_cast<size_t>(static_cast<const imgpel*>(eol) - map) + 1;
+		if (frame_data + size > map_size) {
+			break;
+		}
+		offsets.push_back(static_cast<long long>(frame_data));
+		pos = frame_data + size;
+	}
+}
+
+void VideoYUV::indexFile()
+{
+	// Jump from frame marker to frame marker, then go back to the first one
+	long long pos = static_cast<long long>(header_size);
+	std::string line;
+	while (seek64(file, pos) == 0 && readLine(line) && line.compare(0, Y4M_FRAME_SIZE, Y4M_FRAME) == 0) {
+		long long frame_data = pos + static_cast<long long>(line.size()) + 1;
+		pos = frame_data + static_cast<long long>(size);
+		// Check that the frame is complete
+		if (seek64(file, pos - 1) != 0 || getc(file) == EOF) {
+			break;
+		}
+		offsets.push_back(frame_data);
+	}
+
+	if (seek64(file, static_cast<long long>(header_size)) != 0) {
+		fprintf(stderr, "VideoYUV: cannot seek in input file.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+long long VideoYUV::frameOffset(int frame) const
+{
+	if (y4m) {
+		return offsets[static_cast<size_t>(frame)];
+	}
+	return static_cast<long long>(frame) * static_cast<long long>(size);
+}
+
+int VideoYUV::getFrameCount() const
+{
+	return map ? nbmapped : static_cast<int>(offsets.size());
+}
+
+void VideoYUV::setFrame(const imgpel *frame_data)
+{
+	// The planes are read in place as unsigned short, so on big-endian
+	// hosts the samples are first swapped into 'data'
+	if (BIG_ENDIAN_HOST && bps == 2) {
+		if (data == nullptr) {
+			data = new imgpel[size];
+		}
+		swapBytes(data, frame_data, size / 2);
+		frame_data = data;
+	}
+	luma = frame_data;
+	chroma[0] = frame_data+comp_size[0]*bps;
+	chroma[1] = frame_data+(comp_size[0]+comp_size[1])*bps;
+	yuv_ready = false;
+}
+
+void VideoYUV::startPrefetch(int depth)
+{
+	if (map || reader || depth <= 0) {
+		return;
+	}
+
+	ring = new FrameRing(size, depth);
+	reader = new std::thread(&VideoYUV::prefetch, this);
+}
+
+void VideoYUV::prefetch()
+{
+	imgpel *slot;
+	while ((slot = ring->acquireFree()) != nullptr) {
+		if ((y4m && !readFrameHeader()) || readInput(slot, size) != size) {
+			break;
+		}
+		ring->publish();
+	}
+	// eof is seen by the consumer once it gets no frame, after finish()
+	ring->finish();
+}
 
-			ptr += width * 3;
-			lptr += width;
-			next_line_ptr += width * 3;
-			next_line_lptr += width;
-		}
-	} else if (chf == CHROMA_SUBSAMP_422) {
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; x += 2) {
-				*ptr++ = *lptr++;
-				*ptr++ = *c0;
-				*ptr++ = *c1;
-
-				*ptr++ = *lptr++;
-				*ptr++ = *c0++;
-				*ptr++ = *c1++;
+bool VideoYUV::readOneFrame()
+{
+	if (map) {
+		return readFrame(frame_no);
+	}
+
+	if (reader) {
+		// The previous frame is not used anymore, give its slot back
+		if (frame_held) {
+			ring->release();
+			frame_held = false;
+		}
+		const imgpel *slot = ring->acquireReady();
+		if (!slot) {
+			if (!eof) {
+				fprintf(stderr, "readOneFrame: cannot read %zu bytes from input file, unexpected EOF.\n", size);
 			}
+			return false;
+		}
+		setFrame(slot);
+		frame_held = true;
+		frame_no++;
+
+		return true;
+	}
+
+	if (y4m && !readFrameHeader()) {
+		if (!eof) {
+			fprintf(stderr, "readOneFrame: cannot read Y4M frame marker from input file, unexpected EOF.\n");
+		}
+		return false;
+	}
+
+	return readFrameData();
+}
+
+bool VideoYUV::readFrameData()
+{
+	size_t nbread = readInput(data, size);
+	if (nbread != size) {
+		if (!eof) {
+			fprintf(stderr, "readOneFrame: cannot read %zu bytes from input file, unexpected EOF after %zu bytes.\n", size, nbread);
+		}
+		return false;
+	}
+	setFrame(data);
+	frame_no++;
+
+	return true;
+}
+
+bool VideoYUV::readFrame(int frame)
+{
+	if (map) {
+		if (frame < 0 || frame >= nbmapped) {
+			fprintf(stderr, "readFrame: cannot read frame %d, the input file only contains %d frames.\n", frame, nbmapped);
+			eof = frame >= nbmapped;
+			return false;
 		}
-	} else if (chf == CHROMA_SUBSAMP_444) {
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				*ptr++ = *lptr++;
-				*ptr++ = *c0++;
-				*ptr++ = *c1++;
+		setFrame(map + frameOffset(frame));
+		frame_no = frame + 1;
+
+#ifndef _WIN32
+		// Ask for the next frame to be paged in while this one is processed
+		if (frame_no < nbmapped) {
+			size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			size_t next = static_cast<size_t>(frameOffset(frame_no));
+			size_t start = next & ~(page - 1);
+			madvise(map + start, next + size - start, MADV_WILLNEED);
+		}
+#endif
+
+		return true;
+	}
+
+	if (frame != frame_no) {
+		// Inputs which cannot be repositioned are read up to the frame
+		if (reader || !seekable) {
+			if (frame < frame_no) {
+				fprintf(stderr, "readFrame: cannot go back to frame %d in a stream input.\n", frame);
+				return false;
+			}
+			while (frame_no < frame) {
+				if (!readOneFrame()) {
+					return false;
+				}
 			}
+			return readOneFrame();
 		}
+		if (frame < 0 || (y4m && static_cast<size_t>(frame) >= offsets.size()) ||
+			seek64(file, frameOffset(frame)) != 0) {
+			fprintf(stderr, "readFrame: cannot seek to frame %d in input file.\n", frame);
+			return false;
+		}
+		frame_no = frame;
+		peeked.clear();
+
+		// The position is the one of the frame data, after its Y4M marker
+		return readFrameData();
+	}
+
+	return readOneFrame();
+}
+
+imgpel *VideoYUV::getYUV()
+{
+	if (yuv_ready) return yuv_data;
+
+	if (bps == 2) {
+		interleave(reinterpret_cast<unsigned short*>(yuv_data), reinterpret_cast<const unsigned short*>(luma),
+			reinterpret_cast<const unsigned short*>(chroma[0]), reinterpret_cast<const unsigned short*>(chroma[1]),
+			height, width, chf);
+	}
+	else {
+		interleave(yuv_data, luma, chroma[0], chroma[1], height, width, chf);
 	}
 
 	yuv_ready = true;
@@ -176,29 +679,33 @@ imgpel *VideoYUV::getYUV()
 
 void VideoYUV::getLuma(cv::Mat& local_luma, int type)
 {
-	cv::Mat tmp(height, width, CV_8UC1, luma);
-	if (type == CV_8UC1) {
-		tmp.copyTo(local_luma);
+	cv::Mat tmp = getPlane(0);
+	if (type == tmp.type()) {
+		local_luma = tmp;
 	}
 	else {
 		tmp.convertTo(local_luma, type);
 	}
 }
 
+cv::Mat VideoYUV::getPlane(int comp) const
+{
+	const imgpel *plane = comp == 0 ? luma : chroma[comp-1];
+	return cv::Mat(comp_height[comp], comp_width[comp], bps == 2 ? CV_16UC1 : CV_8UC1, const_cast<imgpel*>(plane));
+}
+
 void VideoYUV::getYUV(cv::Mat& yuv)
 {
-	cv::Mat tmp(height, width, CV_8UC3, getYUV());
+	cv::Mat tmp(height, width, bps == 2 ? CV_16UC3 : CV_8UC3, getYUV());
 	tmp.convertTo(yuv, yuv.type());
 }
 
 void VideoYUV::getU(cv::Mat& u)
 {
-	cv::Mat tmp(comp_height[1], comp_width[1], CV_8UC1, chroma[0]);
-	tmp.convertTo(u, u.type());
+	getPlane(1).convertTo(u, u.type());
 }
 
 void VideoYUV::getV(cv::Mat& v)
 {
-	cv::Mat tmp(comp_height[2], comp_width[2], CV_8UC1, chroma[1]);
-	tmp.convertTo(v, v.type());
+	getPlane(2).convertTo(v, v.type());
 }
@@ -23,25 +23,74 @@
 //
 
 #include "WSPSNR.hpp"
+#include "Kernels.hpp"
 #include "math.h"
 
-WSPSNR::WSPSNR(int h, int w) : Metric(h, w)
+WSPSNR::WSPSNR(int h, int w, int chroma_height, int bitdepth) : Metric(h, w, CV_32F, bitdepth),
+  luma_weights(rowWeights(h)), chroma_weights(rowWeights(chroma_height))
 {
 }
 
-float WSPSNR::compute(const cv::Mat& original, const cv::Mat& processed)
+std::vector<double> WSPSNR::rowWeights(int rows)
 {
-	cv::Mat tmp (height, width,  CV_32F);
-    cv::Mat weights (height, width, CV_32F);
+	std::vector<double> weights(static_cast<size_t>(rows));
+	for (int j = 0; j < rows; j++) {
+		weights[static_cast<size_t>(j)] = cos((j + 0.5 - (rows / 2.0)) * M_PI / rows);
+	}
+	return weights;
+}
 
-    for (int j = 0; j < height; j++)
-        for (int i = 0; i < width; i++)
-            weights.at<float>(j, i) = static_cast<float> (cos ((j + 0.5 - (height / 2.0)) * M_PI / height));
+float WSPSNR::compute(const cv::Mat& original, const cv::Mat& processed, Workspace& /* ws */) const
+{
+	// mean(weights.*(original-processed).^2), one row at a time
+	double sum = 0.0;
+	for (int y = 0; y < original.rows; y++) {
+		sum += luma_weights[static_cast<size_t>(y)] * Kernels::sumSquaredDiff(original.ptr<float>(y), processed.ptr<float>(y), original.cols);
+	}
 
-	cv::subtract(original, processed, tmp);
+	return fromMSE(sum / (static_cast<double>(original.rows) * original.cols));
+}
 
-	cv::multiply(tmp, tmp, tmp);
-    cv::multiply(tmp, weights, tmp);
+float WSPSNR::compute(const cv::Mat& original, const cv::Mat& processed) const
+{
+	return fromMSE(weightedMSE(original, processed, luma_weights));
+}
+
+float WSPSNR::compute(const cv::Mat *original, const cv::Mat *processed, const double *weights, float *planes) const
+{
+	double sum = 0.0;
+	double sum_weights = 0.0;
+	for (int c = 0; c < 3; c++) {
+		planes[c] = 0.0f;
+		if (original[c].empty()) {
+			continue;
+		}
+		double mse = weightedMSE(original[c], processed[c], c == 0 ? luma_weights : chroma_weights);
+		planes[c] = fromMSE(mse);
+		sum += weights[c] * mse;
+		sum_weights += weights[c];
+	}
 
-	return float(10*log10(255*255/cv::mean(tmp).val[0]));
+	return sum_weights > 0.0 ? fromMSE(sum / sum_weights) : 0.0f;
+}
+
+double WSPSNR::weightedMSE(const cv::Mat& a, const cv::Mat& b, const std::vector<double>& weights)
+{
+	double sum = 0.0;
+	for (int y = 0; y < a.rows; y++) {
+		uint64_t sse;
+		if (a.depth() == CV_16U) {
+			sse = Kernels::sumSquaredDiff(a.ptr<unsigned short>(y), b.ptr<unsigned short>(y), a.cols);
+		}
+		else {
+			sse = Kernels::sumSquaredDiff(a.ptr<unsigned char>(y), b.ptr<unsigned char>(y), a.cols);
+		}
+		sum += weights[static_cast<size_t>(y)] * static_cast<double>(sse);
+	}
+	return sum / (static_cast<double>(a.rows) * a.cols);
+}
+
+float WSPSNR::fromMSE(double mse) const
+{
+	return float(10*log10(static_cast<double>(peak)*static_cast<double>(peak)/mse));
 }
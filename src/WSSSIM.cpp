@@ -40,38 +40,45 @@
 const double WSSSIM::C1 = 6.5025;
 const double WSSSIM::C2 = 58.5225;
 
-WSSSIM::WSSSIM (int h, int w) : Metric(h, w)
+struct WSSSIM::State : Workspace::State {
+    LineBuffers lines;
+};
+
+WSSSIM::WSSSIM (int h, int w, int bitdepth) : Metric(h, w, CV_32F, bitdepth),
+    window(cv::getGaussianKernel(11, 1.5, CV_32F))
 {
 }
 
-float WSSSIM::compute (const cv::Mat& original, const cv::Mat& processed)
+float WSSSIM::compute (const cv::Mat& original, const cv::Mat& processed, Workspace& ws) const
 {
-    cv::Scalar res = computeWSSSIM(original, processed);
+    cv::Scalar res = computeWSSSIM(original, processed, ws);
     return float(res.val[0]);
 }
 
-cv::Scalar WSSSIM::computeWSSSIM (const cv::Mat& img1, const cv::Mat& img2)
+cv::Scalar WSSSIM::computeWSSSIM (const cv::Mat& img1, const cv::Mat& img2, Workspace& ws) const
 {
+    LineBuffers& lines = ws.state<State>(this).lines;
+    Arena& arena = ws.getArena();
 
     int ht = img1.rows;
     int wt = img1.cols;
     int w = wt - 10;
     int h = ht - 10;
 
-    cv::Mat mu1(h, w, CV_32F), mu2(h, w, CV_32F);
-    cv::Mat mu1_sq(h, w, CV_32F), mu2_sq(h, w, CV_32F), mu1_mu2(h, w, CV_32F);
-    cv::Mat img1_sq(ht, wt, CV_32F), img2_sq(ht, wt, CV_32F), img1_img2(ht, wt, CV_32F);
-    cv::Mat sigma1_sq(h, w, CV_32F), sigma2_sq(h, w, CV_32F), sigma12(h, w, CV_32F);
-    cv::Mat tmp1(h, w, CV_32F), tmp2(h, w, CV_32F), tmp3(h, w, CV_32F);
-    cv::Mat ssim_map(h, w, CV_32F), cs_map(h, w, CV_32F);
+    cv::Mat mu1 = arena.mat(h, w, CV_32F), mu2 = arena.mat(h, w, CV_32F);
+    cv::Mat mu1_sq = arena.mat(h, w, CV_32F), mu2_sq = arena.mat(h, w, CV_32F), mu1_mu2 = arena.mat(h, w, CV_32F);
+    cv::Mat img1_sq = arena.mat(ht, wt, CV_32F), img2_sq = arena.mat(ht, wt, CV_32F), img1_img2 = arena.mat(ht, wt, CV_32F);
+    cv::Mat sigma1_sq = arena.mat(h, w, CV_32F), sigma2_sq = arena.mat(h, w, CV_32F), sigma12 = arena.mat(h, w, CV_32F);
+    cv::Mat tmp1 = arena.mat(h, w, CV_32F), tmp2 = arena.mat(h, w, CV_32F), tmp3 = arena.mat(h, w, CV_32F);
+    cv::Mat ssim_map = arena.mat(h, w, CV_32F), cs_map = arena.mat(h, w, CV_32F);
 
-    cv::Mat weights (h, w, CV_32F);
+    cv::Mat weights = arena.mat(h, w, CV_32F);
 
     // mu1 = filter2(window, img1, 'valid');
-    applyGaussianBlur(img1, mu1, 11, 1.5);
+    applyGaussianBlur(img1, mu1, window, lines);
 
     // mu2 = filter2(window, img2, 'valid');
-    applyGaussianBlur(img2, mu2, 11, 1.5);
+    applyGaussianBlur(img2, mu2, window, lines);
 
     // mu1_sq = mu1.*mu1;
     cv::multiply(mu1, mu1, mu1_sq);
@@ -85,30 +92,33 @@ cv::Scalar WSSSIM::computeWSSSIM (const cv::Mat& img1, const cv::Mat& img2)
     cv::multiply(img1, img2, img1_img2);
 
     // sigma1_sq = filter2(window, img1.*img1, 'valid') - mu1_sq;
-    applyGaussianBlur(img1_sq, sigma1_sq, 11, 1.5);
+    applyGaussianBlur(img1_sq, sigma1_sq, window, lines);
     sigma1_sq -= mu1_sq;
 
     // sigma2_sq = filter2(window, img2.*img2, 'valid') - mu2_sq;
-    applyGaussianBlur(img2_sq, sigma2_sq, 11, 1.5);
+    applyGaussianBlur(img2_sq, sigma2_sq, window, lines);
     sigma2_sq -= mu2_sq;
 
     // sigma12 = filter2(window, img1.*img2, 'valid') - mu1_mu2;
-    applyGaussianBlur(img1_img2, sigma12, 11, 1.5);
+    applyGaussianBlur(img1_img2, sigma12, window, lines);
     sigma12 -= mu1_mu2;
 
+    const double c1 = C1 * static_cast<double>(range_sq);
+    const double c2 = C2 * static_cast<double>(range_sq);
+
     // cs_map = (2*sigma12 + C2)./(sigma1_sq + sigma2_sq + C2);
-    tmp1 = 2*sigma12 + C2;
-    tmp2 = sigma1_sq + sigma2_sq + C2;
+    tmp1 = 2*sigma12 + c2;
+    tmp2 = sigma1_sq + sigma2_sq + c2;
     cv::divide(tmp1, tmp2, cs_map);
     // ssim_map = ((2*mu1_mu2 + C1).*(2*sigma12 + C2))./((mu1_sq + mu2_sq + C1).*(sigma1_sq + sigma2_sq + C2));
-    tmp3 = 2*mu1_mu2 + C1;
+    tmp3 = 2*mu1_mu2 + c1;
     cv::multiply(tmp1, tmp3, tmp1);
-    tmp3 = mu1_sq + mu2_sq + C1;
+    tmp3 = mu1_sq + mu2_sq + c1;
     cv::multiply(tmp2, tmp3, tmp2);
     cv::divide(tmp1, tmp2, ssim_map);
 
-    for (int j = 0; j < height; j++)
-        for (int i = 0; i < width; i++)
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++)
             weights.at<float>(j, i) = static_cast<float> (cos ((j + 0.5 - (height / 2.0)) * M_PI / height));
 
     double sum_weights = cv::sum( weights )[0];
@@ -0,0 +1,65 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include "Workspace.hpp"
+
+Workspace::State::~State()
+{
+}
+
+Workspace::Workspace() : cache(nullptr), pool(nullptr)
+{
+}
+
+Workspace::~Workspace()
+{
+	for (size_t i = 0; i < entries.size(); i++) {
+		delete entries[i].state;
+	}
+}
+
+void Workspace::clear()
+{
+	arena.reset();
+}
+
+void Workspace::setCache(FeatureCache *c)
+{
+	cache = c;
+}
+
+FeatureCache *Workspace::getCache() const
+{
+	return cache;
+}
+
+void Workspace::setThreadPool(ThreadPool *p)
+{
+	pool = p;
+}
+
+ThreadPool *Workspace::getThreadPool() const
+{
+	return pool;
+}
@@ -27,12 +27,16 @@
  Usage:
   VQMT.exe OriginalVideo ProcessedVideo Height Width NumberOfFrames ChromaFormat Output Metrics
 
-  OriginalVideo: the original video as raw YUV video file, progressively scanned, and 8 bits per sample
-  ProcessedVideo: the processed video as raw YUV video file, progressively scanned, and 8 bits per sample
-  Height: the height of the video
-  Width: the width of the video
-  NumberOfFrames: the number of frames to process
+  OriginalVideo: the original video as raw YUV video file, progressively scanned, and 8 bits per sample (see --bitdepth),
+                 or as Y4M (YUV4MPEG2) file
+  ProcessedVideo: the processed video as raw YUV video file, progressively scanned, and 8 bits per sample (see --bitdepth),
+                  or as Y4M (YUV4MPEG2) file
+  Height: the height of the video (0: from the Y4M header)
+  Width: the width of the video (0: from the Y4M header)
+  NumberOfFrames: the number of frames to process, from the start frame with the stride (0: all the frames of
+                  the input files, or until the end of the inputs when they are all streams such as stdin or pipes)
   ChromaFormat: the chroma subsampling format. 0: YUV400, 1: YUV420, 2: YUV422, 3: YUV444
+                (ignored for Y4M files, as the bit depth, which are given by the header)
   Output: the name of the output file(s)
   Metrics: the list of metrics to use
    available metrics:
@@ -42,9 +46,40 @@
    - VIFP: Visual Information Fidelity, pixel domain version (VIFp)
    - PSNRHVS: Peak Signal-to-Noise Ratio taking into account Contrast Sensitivity Function (CSF) (PSNR-HVS)
    - PSNRHVSM: Peak Signal-to-Noise Ratio taking into account Contrast Sensitivity Function (CSF) and between-coefficient contrast masking of DCT basis functions (PSNR-HVS-M)
+   - YUVPSNR: PSNR of the Y, U and V planes, and of their mean squared errors weighted by --yuv-weights
+   - YUVSSIM: SSIM of the Y, U and V planes at their own size, and their mean weighted by --yuv-weights
 
 And also Spherical metrics:
    - WSPSNR: Weighted-to-spherical PSNR
+   - YUVWSPSNR: WSPSNR of the Y, U and V planes, each with the row weights of its height, and of their
+                weighted mean squared errors weighted by --yuv-weights
+
+  Options (may be mixed with the metrics):
+   --processed FILE: another processed video compared to the same original video (may be repeated);
+                     the original frames and the terms of the metrics which only depend on them are
+                     computed once, the results of the n-th processed video (from 1, ProcessedVideo
+                     first) go to Output_n_metric.csv
+   --start N: index of the first frame to measure (default: 0)
+   --stride N: measure one frame every N frames (default: 1); the frames
+               in between are skipped without being read when the input is seekable
+   --sample N: measure N frames chosen at random among the selected ones
+   --seed N: seed of the random selection of --sample (default: 0)
+   --prefetch N: number of frames read ahead in a background thread for
+                 inputs which are not memory-mapped, such as stdin (default: 4, 0 to disable)
+   --threads N: number of frames computed in parallel (default: 1)
+   --bands: compute one frame at a time, SSIM, MS-SSIM, VIFp and PSNR-HVS(-M) splitting it in bands of rows
+            computed by the --threads threads, for a lower latency per frame
+   --hugepages: back the scratch memory of the metrics with transparent huge pages, where supported
+   --bitdepth N: number of bits per sample, from 8 to 16 (default: 8); above 8 bits, each
+                 sample is stored on 2 bytes in little-endian order
+   --yuv-weights WY:WU:WV: weights of the Y, U and V planes in YUVPSNR, YUVSSIM and YUVWSPSNR (default: 1:1:1),
+                          e.g. 6:1:1
+   --cpu LEVEL: instruction set of the metric kernels: generic, sse4.2, avx2 or avx512
+                (default: the most capable one supported by the CPU)
+   --percentiles P1:P2:...: percentiles given in the summary of each metric, from 0 to 100
+                            (default: 50:90:95:99)
+   --snapshot N: write the summary of the frames measured so far to Output_metric_summary.csv
+                 every N measured frames, as they are computed
 
  Example:
   VQMT.exe original.yuv processed.yuv 1088 1920 250 1 results PSNR SSIM MSSSIM VIFP
@@ -59,6 +94,17 @@ And also Spherical metrics:
  - PSNRHVS and PSNRHVSM are always computed at the same time (but you still need to specify both to get the two outputs)
  - When using MSSSIM, the height and width of the video have to be multiple of 16
  - When using VIFP, the height and width of the video have to be multiple of 8
+ - When using PSNRHVS or PSNRHVSM, the height and width of the video have to be multiple of 8
+ - The output files of YUVPSNR, YUVSSIM and YUVWSPSNR have the columns value,y,u,v: the weighted value, then the value
+   of each plane (0 for the chroma planes of YUV400 videos, which are left out)
+ - The summary of PSNR and YUVPSNR also gives their global value, the PSNR of the mean squared error
+   of all the measured frames, with the sums of the squared errors and the numbers of samples
+ - PSNR, YUVPSNR, WSPSNR and YUVWSPSNR are computed on the integer samples, without converting them
+   to floating point: when they are the only metrics, the frames are not converted
+ - The results are written to the output files as soon as they are computed, and the buffer of pipe
+   inputs is enlarged to two frames where supported (Linux)
+ - The statistics of the summary are computed in a single pass with a bounded memory, the percentiles
+   are exact up to 200 frames and estimated by a t-digest beyond
 
  Changes in version 1.1 (since 1.0) on 30/3/13
  - Added support for large files (>2GB)
@@ -66,20 +112,22 @@ And also Spherical metrics:
 
 **************************************************************************/
 
+#include <algorithm>
 #include <iostream>
 #include <format>
+#include <random>
+#include <string>
+#include <vector>
 #include <string.h>
 #include <opencv2/core/core.hpp>
+#include "FeatureCache.hpp"
+#include "FrameSet.hpp"
+#include "Kernels.hpp"
+#include "Statistics.hpp"
+#include "ThreadPool.hpp"
 #include "VideoYUV.hpp"
-#include "PSNR.hpp"
-#include "SSIM.hpp"
-#include "MSSSIM.hpp"
-#include "VIFP.hpp"
-#include "PSNRHVS.hpp"
-#include "EWPSNR.hpp"
-
-// Spherical metrics
-#include "WSPSNR.hpp"
+#include "Workspace.hpp"
+#include "MetricRegistry.hpp"
 
 enum Params {
 	PARAM_ORIGINAL = 1,	// Original video stream (YUV)
@@ -93,22 +141,29 @@ enum Params {
 	PARAM_SIZE
 };
 
-enum Metrics {
-	METRIC_PSNR = 0,
-	METRIC_YUVPSNR,
-	METRIC_SSIM,
-	METRIC_YUVSSIM,
-	METRIC_MSSSIM,
-	METRIC_VIFP,
-	METRIC_PSNRHVS,
-	METRIC_PSNRHVSM,
-	METRIC_EWPSNR,
-	METRIC_WSPSNR,
-	METRIC_SIZE
+// Output files and results of one processed video
+// The c-th column of a metric for the frame of the b-th slot of a batch is
+// stored in results[m][c*nbslots+b], see MetricRegistry::columns(), and
+// added to stats[m][c] when the frame is printed, so that the memory does
+// not depend on the number of frames.
+struct Output {
+	FILE *file[METRIC_SIZE];
+	std::string summary[METRIC_SIZE];	// file of the snapshots
+	float *results[METRIC_SIZE];
+	Statistics stats[METRIC_SIZE][MetricRegistry::MAX_COLUMNS];
+	int nbslots;
 };
 
-static int float_compare (const void * a, const void * b);
-static float calculate_percentile (const float* results, int nbframes, float p);
+static bool parse_int (const char *str, int& value);
+static bool parse_weights (const char *str, double *weights);
+static bool parse_percentiles (const char *str, std::vector<double>& percentiles);
+static void select_frames (int start, int stride, int count, int sample, int seed, std::vector<int>& frames);
+static void print_statistics (FILE *file, const Output& output, int metric, const std::vector<double>& percentiles);
+static bool write_snapshot (const MetricRegistry& registry, const Output& output, size_t index, int metric, int frame,
+	const std::vector<double>& percentiles, const std::vector<Workspace>& workspaces);
+static void compute_metrics (const MetricRegistry& registry, int index, int frame, const FrameSet& set, std::vector<Output>& outputs, Workspace& ws);
+static float result (const Output& output, int metric, int index);
+static void get_planes (const VideoYUV& video, cv::Mat *planes, bool copy);
 
 int main (int argc, const char **argv)
 {
@@ -143,249 +198,584 @@ int main (int argc, const char **argv)
 		return EXIT_FAILURE;
 	}
 
-	// Input video streams
-	VideoYUV *original  = new VideoYUV(argv[PARAM_ORIGINAL], height, width, nbframes, chroma);
-	VideoYUV *processed = new VideoYUV(argv[PARAM_PROCESSED], height, width, nbframes, chroma);
-
-	// Output files for results
-	FILE *result_file[METRIC_SIZE] = {nullptr};
-	char *str = new char[256];
-	for (int i = 7; i < argc; i++) {
-		if (strcmp(argv[i], "PSNR") == 0 || strcmp(argv[i], "YPSNR") == 0) {
-			sprintf(str, "%s_psnr.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_PSNR] = fopen(str, "w");
-		} else if (strcmp(argv[i], "YUVPSNR") == 0) {
-			sprintf(str, "%s_yuvpsnr.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_YUVPSNR] = fopen(str, "w");
-		} else if (strcmp(argv[i], "SSIM") == 0) {
-			sprintf(str, "%s_ssim.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_SSIM] = fopen(str, "w");
-		} else if (strcmp(argv[i], "YUVSSIM") == 0) {
-			sprintf(str, "%s_yuvssim.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_YUVSSIM] = fopen(str, "w");
-		} else if (strcmp(argv[i], "MSSSIM") == 0) {
-			sprintf(str, "%s_msssim.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_MSSSIM] = fopen(str, "w");
-		} else if (strcmp(argv[i], "VIFP") == 0) {
-			sprintf(str, "%s_vifp.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_VIFP] = fopen(str, "w");
-		} else if (strcmp(argv[i], "PSNRHVS") == 0) {
-			sprintf(str, "%s_psnrhvs.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_PSNRHVS] = fopen(str, "w");
-		} else if (strcmp(argv[i], "PSNRHVSM") == 0) {
-			sprintf(str, "%s_psnrhvsm.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_PSNRHVSM] = fopen(str, "w");
-		} else if (strcmp(argv[i], "EWPSNR") == 0) {
-			sprintf(str, "%s_ewpsnr.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_EWPSNR] = fopen(str, "w");
-		} else if (strcmp(argv[i], "WSPSNR") == 0) {
-			sprintf(str, "%s_wspsnr.csv", argv[PARAM_RESULTS]);
-			result_file[METRIC_WSPSNR] = fopen(str, "w");
+	// Options and output files for results
+	int prefetch = 4;
+	int nbthreads = 1;
+	bool bands = false;
+	bool huge_pages = false;
+	int bitdepth = 8;
+	int start = 0;
+	int stride = 1;
+	int sample = 0;
+	int seed = 0;
+	double yuv_weights[3] = {1.0, 1.0, 1.0};
+	std::vector<double> percentiles = {50, 90, 95, 99};
+	int snapshot = 0;
+	bool requested[METRIC_SIZE] = {false};
+	std::vector<const char*> processed_files(1, argv[PARAM_PROCESSED]);
+	for (int i = PARAM_METRICS; i < argc; i++) {
+		if (strcmp(argv[i], "--processed") == 0) {
+			if (i + 1 >= argc) {
+				fprintf(stderr, "Missing file name for option --processed\n");
+				return EXIT_FAILURE;
+			}
+			processed_files.push_back(argv[++i]);
+		} else if (strcmp(argv[i], "--prefetch") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], prefetch) || prefetch < 0) {
+				fprintf(stderr, "Incorrect value for option --prefetch\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--threads") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], nbthreads) || nbthreads < 1) {
+				fprintf(stderr, "Incorrect value for option --threads\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--bands") == 0) {
+			bands = true;
+		} else if (strcmp(argv[i], "--hugepages") == 0) {
+			huge_pages = true;
+		} else if (strcmp(argv[i], "--start") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], start) || start < 0) {
+				fprintf(stderr, "Incorrect value for option --start\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--stride") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], stride) || stride < 1) {
+				fprintf(stderr, "Incorrect value for option --stride\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--sample") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], sample) || sample < 1) {
+				fprintf(stderr, "Incorrect value for option --sample\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--seed") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], seed)) {
+				fprintf(stderr, "Incorrect value for option --seed\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--bitdepth") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], bitdepth) || bitdepth < 8 || bitdepth > 16) {
+				fprintf(stderr, "Incorrect value for option --bitdepth\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--yuv-weights") == 0) {
+			if (i + 1 >= argc || !parse_weights(argv[++i], yuv_weights)) {
+				fprintf(stderr, "Incorrect value for option --yuv-weights\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--percentiles") == 0) {
+			if (i + 1 >= argc || !parse_percentiles(argv[++i], percentiles)) {
+				fprintf(stderr, "Incorrect value for option --percentiles\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--snapshot") == 0) {
+			if (i + 1 >= argc || !parse_int(argv[++i], snapshot) || snapshot < 1) {
+				fprintf(stderr, "Incorrect value for option --snapshot\n");
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--cpu") == 0) {
+			Kernels::Level level;
+			if (i + 1 >= argc || !Kernels::parse(argv[++i], level)) {
+				fprintf(stderr, "Incorrect value for option --cpu\n");
+				return EXIT_FAILURE;
+			}
+			if (!Kernels::select(level)) {
+				fprintf(stderr, "Instruction set not supported by this CPU: %s\n", Kernels::name(level));
+				return EXIT_FAILURE;
+			}
+		} else {
+			int m = MetricRegistry::find(argv[i]);
+			if (m >= 0) {
+				requested[m] = true;
+			}
 		}
 	}
-	delete[] str;
 
-	// Check size for VIFp downsampling
-	if (result_file[METRIC_VIFP] != nullptr && (height % 8 != 0 || width % 8 != 0)) {
-		fprintf(stderr, "VIFp: 'height' and 'width' have to be multiple of 8.\n");
-		exit(EXIT_FAILURE);
-	}
-	// Check size for MS-SSIM downsampling
-	if (result_file[METRIC_MSSSIM] != nullptr && (height % 16 != 0 || width % 16 != 0)) {
-		fprintf(stderr, "MS-SSIM: 'height' and 'width' have to be multiple of 16.\n");
-		exit(EXIT_FAILURE);
+	// Input video streams
+	// The geometry of Y4M inputs comes from their header, the processed
+	// video has to match the original one
+	VideoYUV *original  = new VideoYUV(argv[PARAM_ORIGINAL], height, width, nbframes, chroma, bitdepth);
+	height = original->getHeight();
+	width = original->getWidth();
+	chroma = original->getChromaFormat();
+	bitdepth = original->getBitDepth();
+	std::vector<VideoYUV*> processed;
+	for (size_t i = 0; i < processed_files.size(); i++) {
+		processed.push_back(new VideoYUV(processed_files[i], height, width, nbframes, chroma, bitdepth));
+		if (processed[i]->getChromaFormat() != chroma || processed[i]->getBitDepth() != bitdepth) {
+			fprintf(stderr, "The chroma format and bit depth of the processed video have to match the original video: %s\n", processed_files[i]);
+			return EXIT_FAILURE;
+		}
 	}
-
-	// Print header to file
-	for (int m = 0; m < METRIC_SIZE; m++) {
-		if (result_file[m] != nullptr) {
-			fprintf(result_file[m], "frame,value\n");
+	size_t nbprocessed = processed.size();
+
+	// Number of frames of the input files from the start frame if not given
+	// When none of the inputs knows its number of frames, they are all
+	// streams which are read until the end of the first one to end
+	bool until_eof = false;
+	if (nbframes == 0) {
+		int available = original->getFrameCount();
+		for (size_t i = 0; i < nbprocessed; i++) {
+			int nbp = processed[i]->getFrameCount();
+			available = available == 0 ? nbp : (nbp == 0 ? available : std::min(available, nbp));
+		}
+		if (available == 0) {
+			if (sample > 0) {
+				fprintf(stderr, "The number of frames is required for option --sample with stream inputs.\n");
+				return EXIT_FAILURE;
+			}
+			until_eof = true;
+		}
+		else {
+			nbframes = available > start ? (available - start + stride - 1) / stride : 0;
 		}
 	}
 
-	PSNR *psnr     = new PSNR(height, width, CV_32F);
-	PSNR *yuvpsnr  = new PSNR(height, width, CV_32FC3);
-	SSIM *ssim     = new SSIM(height, width, CV_32F);
-	SSIM *yuvssim  = new SSIM(height, width, CV_32FC3);
-	MSSSIM *msssim = new MSSSIM(height, width);
-	VIFP *vifp     = new VIFP(height, width);
-	PSNRHVS *phvs  = new PSNRHVS(height, width);
-	EWPSNR *ewpsnr = new EWPSNR(height, width);
-	WSPSNR *wspsnr = new WSPSNR(height, width);
-
-	if (result_file[METRIC_EWPSNR] != NULL) {
-		ewpsnr->match_eye_track_data(argv[PARAM_ORIGINAL]);
+	// Frames to measure, in increasing order: NumberOfFrames frames from
+	// the start frame with the given stride, or a random sample of them
+	// Until the end of the inputs, the k-th frame measured is start+k*stride.
+	std::vector<int> frames;
+	select_frames(start, stride, nbframes, sample, seed, frames);
+	int nbmeasured = static_cast<int>(frames.size());
+	if (nbmeasured == 0 && !until_eof) {
+		fprintf(stderr, "No frame to measure.\n");
+		return EXIT_FAILURE;
 	}
+	auto frame_at = [&](int k) {
+		return until_eof ? start + k * stride : frames[static_cast<size_t>(k)];
+	};
 
+	original->startPrefetch(prefetch);
+	for (size_t i = 0; i < nbprocessed; i++) {
+		processed[i]->startPrefetch(prefetch);
+	}
 
-	cv::Mat original_frame(height, width, CV_32F), processed_frame(height, width, CV_32F);
-	cv::Mat original_frame3(height, width, CV_32FC3), processed_frame3(height, width, CV_32FC3);
-
-	float* results[METRIC_SIZE];
-
-	for (int m = 0; m < METRIC_SIZE; m++)
-		results[m] = static_cast<float*>(calloc(static_cast<size_t>(nbframes), sizeof(float)));
+	// Providers of the requested metrics, and check size for their
+	// downsampling (MS-SSIM, VIFp)
+	MetricRegistry registry(requested);
+	if (!registry.checkSize(height, width)) {
+		exit(EXIT_FAILURE);
+	}
 
-	for (int frame = 0; frame < nbframes; frame++) {
-		std::cout << "Computing metrics for frame: No." << frame << std::endl;
+	// Output files for results: <Output>_<metric>.csv with one processed
+	// video, <Output>_<n>_<metric>.csv for the n-th one (from 1) otherwise,
+	// and <Output>[_<n>]_<metric>_summary.csv for the snapshots
+	std::vector<Output> outputs(nbprocessed);
+	char *str = new char[256];
+	for (size_t i = 0; i < nbprocessed; i++) {
+		for (int m = 0; m < METRIC_SIZE; m++) {
+			outputs[i].file[m] = nullptr;
+			outputs[i].results[m] = nullptr;
+			if (!requested[m]) {
+				continue;
+			}
+			if (nbprocessed == 1) {
+				snprintf(str, 256, "%s_%s", argv[PARAM_RESULTS], MetricRegistry::suffix(m));
+			}
+			else {
+				snprintf(str, 256, "%s_%zu_%s", argv[PARAM_RESULTS], i + 1, MetricRegistry::suffix(m));
+			}
+			outputs[i].summary[m] = std::string(str) + "_summary.csv";
+			strncat(str, ".csv", 255 - strlen(str));
+			outputs[i].file[m] = fopen(str, "w");
+			if (outputs[i].file[m] == nullptr) {
+				fprintf(stderr, "Cannot open output file: %s\n", str);
+				exit(EXIT_FAILURE);
+			}
 
-		// Grab frame
-		if (!original->readOneFrame()) {
-			fprintf(stderr, "Error: ran out of original frames to load: %d/%d\n", frame, nbframes);
-			exit(EXIT_FAILURE);
+			// Print header to file
+			fprintf(outputs[i].file[m], "frame,%s\n", MetricRegistry::header(m));
 		}
-		original->getLuma(original_frame, CV_32F);
+	}
+	delete[] str;
 
-		if (!processed->readOneFrame()) {
-			fprintf(stderr, "Error: ran out of processed frames to load: %d/%d\n", frame, nbframes);
-			exit(EXIT_FAILURE);
+	// Each thread computes the metrics of its frames with its own workspace,
+	// which keeps the intermediate results, and its own feature cache, which
+	// the metrics of a frame share
+	// With --bands, the frames are computed one at a time with a single
+	// workspace, the metrics split them in bands computed by all the threads
+	ThreadPool pool(nbthreads);
+	int nbsets = bands ? 1 : pool.size();
+	std::vector<FeatureCache> caches(static_cast<size_t>(nbsets));
+	std::vector<Workspace> workspaces(static_cast<size_t>(nbsets));
+	for (int t = 0; t < nbsets; t++) {
+		workspaces[static_cast<size_t>(t)].setCache(&caches[static_cast<size_t>(t)]);
+		workspaces[static_cast<size_t>(t)].setThreadPool(bands ? &pool : nullptr);
+		workspaces[static_cast<size_t>(t)].getArena().setHugePages(huge_pages);
+	}
+	MetricRegistry::Parameters params = {height, width, original->getChromaHeight(), bitdepth, argv[PARAM_ORIGINAL],
+		{yuv_weights[0], yuv_weights[1], yuv_weights[2]}};
+	registry.create(params);
+	bool need_chroma = registry.needs(MetricRegistry::INPUT_YUV);
+	bool need_luma = need_chroma || registry.needs(MetricRegistry::INPUT_LUMA);
+	bool need_planes = registry.needs(MetricRegistry::INPUT_PLANES);
+
+	// Frames are read in batches, then the frames of a batch are computed in
+	// parallel and their results printed in order
+	// The planes of the samples are copied only when several frames are read
+	// before being computed, otherwise they stay headers on the frame data.
+	int batch_size = nbsets == 1 ? 1 : 2 * nbsets;
+	for (size_t i = 0; i < nbprocessed; i++) {
+		outputs[i].nbslots = batch_size;
+		for (int m = 0; m < METRIC_SIZE; m++) {
+			if (requested[m]) {
+				outputs[i].results[m] = static_cast<float*>(calloc(static_cast<size_t>(batch_size * MetricRegistry::columns(m)), sizeof(float)));
+			}
 		}
-		processed->getLuma(processed_frame, CV_32F);
+	}
+	std::vector<FrameSet> batch(static_cast<size_t>(batch_size));
+	for (int b = 0; b < batch_size; b++) {
+		batch[static_cast<size_t>(b)].allocate(height, width, original->getChromaHeight(), original->getChromaWidth(),
+			need_luma, need_chroma, nbprocessed);
+	}
 
-		if (result_file[METRIC_YUVPSNR] != NULL || result_file[METRIC_YUVSSIM] != NULL) {
-			original->getYUV(original_frame3);
-			processed->getYUV(processed_frame3);
-		}
+	bool end_of_input = false;
+	for (int first = 0; !end_of_input && (until_eof || first < nbmeasured); first += batch_size) {
+		int count = until_eof ? batch_size : std::min(batch_size, nbmeasured - first);
+
+		for (int b = 0; b < count && !end_of_input; b++) {
+			int frame = frame_at(first + b);
+			FrameSet& set = batch[static_cast<size_t>(b)];
+
+			// Grab frame, seeking over the frames which are not measured
+			// The original frame is read once for all the processed videos
+			// Until the end of the inputs, the batch stops at the first frame
+			// missing in one of them.
+			if (!original->readFrame(frame)) {
+				if (until_eof && original->atEnd()) {
+					end_of_input = true;
+					count = b;
+					break;
+				}
+				if (until_eof) {
+					fprintf(stderr, "Error: the original video ends within frame %d\n", frame);
+				}
+				else {
+					fprintf(stderr, "Error: ran out of original frames to load: %d/%d\n", frame, start + nbframes * stride);
+				}
+				exit(EXIT_FAILURE);
+			}
+			if (need_luma) {
+				original->getLuma(set.original, CV_32F);
+			}
+			if (need_chroma) {
+				original->getU(set.original_chroma[0]);
+				original->getV(set.original_chroma[1]);
+			}
+			if (need_planes) {
+				get_planes(*original, set.original_planes, batch_size > 1);
+			}
 
-		// Compute PSNR
-		if (result_file[METRIC_PSNR] != NULL) {
-			results[METRIC_PSNR][frame] = psnr->compute(original_frame, processed_frame);
+			for (size_t i = 0; i < nbprocessed; i++) {
+				if (!processed[i]->readFrame(frame)) {
+					if (until_eof && processed[i]->atEnd()) {
+						end_of_input = true;
+						count = b;
+						break;
+					}
+					if (until_eof) {
+						fprintf(stderr, "Error: the processed video ends within frame %d (%s)\n", frame, processed_files[i]);
+					}
+					else {
+						fprintf(stderr, "Error: ran out of processed frames to load: %d/%d (%s)\n", frame, start + nbframes * stride, processed_files[i]);
+					}
+					exit(EXIT_FAILURE);
+				}
+				if (need_luma) {
+					processed[i]->getLuma(set.processed[i], CV_32F);
+				}
+				if (need_chroma) {
+					processed[i]->getU(set.processed_chroma[2 * i]);
+					processed[i]->getV(set.processed_chroma[2 * i + 1]);
+				}
+				if (need_planes) {
+					get_planes(*processed[i], &set.processed_planes[3 * i], batch_size > 1);
+				}
+			}
 		}
 
-		// Compute EWPSNR
-		if (result_file[METRIC_EWPSNR] != NULL) {
-			ewpsnr->set_frame_no(static_cast<unsigned int>(frame));
-			results[METRIC_EWPSNR][frame] = ewpsnr->compute(original_frame, processed_frame);
+		if (count == 0) {
+			break;
 		}
-
-		// Compute YUVPSNR
-		if (result_file[METRIC_YUVPSNR] != NULL) {
-			results[METRIC_YUVPSNR][frame] = yuvpsnr->compute(original_frame3, processed_frame3);
+		if (until_eof) {
+			nbmeasured = first + count;
 		}
 
-		// Compute SSIM and MS-SSIM
-		if (result_file[METRIC_SSIM] != nullptr && result_file[METRIC_MSSSIM] == nullptr) {
-			results[METRIC_SSIM][frame] = ssim->compute(original_frame, processed_frame);
+		if (bands) {
+			caches[0].clear();
+			workspaces[0].clear();
+			compute_metrics(registry, 0, frame_at(first), batch[0], outputs, workspaces[0]);
 		}
-
-		// Compute YUVSSIM and MS-SSIM
-		if (result_file[METRIC_YUVSSIM] != NULL) {
-			results[METRIC_YUVSSIM][frame] = yuvssim->compute(original_frame3, processed_frame3);
+		else {
+			pool.parallelFor(count, [&](int worker, int b) {
+				caches[static_cast<size_t>(worker)].clear();
+				workspaces[static_cast<size_t>(worker)].clear();
+				compute_metrics(registry, b, frame_at(first + b),
+					batch[static_cast<size_t>(b)], outputs, workspaces[static_cast<size_t>(worker)]);
+			});
 		}
 
-		if (result_file[METRIC_MSSSIM] != nullptr) {
-			msssim->compute(original_frame, processed_frame);
-
-			if (result_file[METRIC_SSIM] != nullptr) {
-				results[METRIC_SSIM][frame] = msssim->getSSIM();
+		for (int k = first; k < first + count; k++) {
+			int frame = frame_at(k);
+			std::cout << "Computing metrics for frame: No." << frame << std::endl;
+
+			for (size_t i = 0; i < nbprocessed; i++) {
+				float* const *results = outputs[i].results;
+				if (nbprocessed > 1) {
+					std::cout << "Processed video " << i + 1 << ": " << processed_files[i] << std::endl;
+				}
+
+				std::cout << std::format("PSNR: {:.3}, WSPSNR: {:.3}\n", result(outputs[i], METRIC_PSNR, k - first), result(outputs[i], METRIC_WSPSNR, k - first));
+
+				// Print quality index to file and add it to the statistics
+				std::cout << ". result: ";
+				for (int m=0; m<METRIC_SIZE; m++) {
+					if (outputs[i].file[m] != nullptr) {
+						fprintf(outputs[i].file[m], "%d", frame);
+						for (int c = 0; c < MetricRegistry::columns(m); c++) {
+							float value = results[m][c * batch_size + k - first];
+							fprintf(outputs[i].file[m], ",%.6f", static_cast<double>(value));
+							outputs[i].stats[m][c].add(static_cast<double>(value));
+						}
+						fprintf(outputs[i].file[m], "\n");
+						std::cout << results[m][k - first] << "  ";
+					}
+				}
+				std::cout << std::endl;
 			}
-
-			results[METRIC_MSSSIM][frame] = msssim->getMSSSIM();
-		}
-
-		// Compute VIFp
-		if (result_file[METRIC_VIFP] != nullptr) {
-			results[METRIC_VIFP][frame] = vifp->compute(original_frame, processed_frame);
 		}
-
-		// Compute PSNR-HVS and PSNR-HVS-M
-		if (result_file[METRIC_PSNRHVS] != nullptr || result_file[METRIC_PSNRHVSM] != nullptr) {
-			phvs->compute(original_frame, processed_frame);
-
-			if (result_file[METRIC_PSNRHVS] != nullptr) {
-				results[METRIC_PSNRHVS][frame] = phvs->getPSNRHVS();
-			}
-
-			if (result_file[METRIC_PSNRHVSM] != nullptr) {
-				results[METRIC_PSNRHVSM][frame] = phvs->getPSNRHVSM();
+		// The results are available as soon as a batch is computed, e.g.
+		// to a reader of the output files while the inputs are produced
+		for (size_t i = 0; i < nbprocessed; i++) {
+			for (int m = 0; m < METRIC_SIZE; m++) {
+				if (outputs[i].file[m] != nullptr) {
+					fflush(outputs[i].file[m]);
+				}
 			}
 		}
 
-		// Compute WSPSNR
-		if (result_file[METRIC_WSPSNR] != nullptr) {
-			results[METRIC_WSPSNR][frame] = wspsnr->compute(original_frame, processed_frame);
+		// Snapshots of the statistics once the batch in which a multiple of
+		// --snapshot frames is reached has been printed, the workspaces being
+		// idle
+		if (snapshot > 0 && (first + count) / snapshot > first / snapshot) {
+			for (size_t i = 0; i < nbprocessed; i++) {
+				for (int m = 0; m < METRIC_SIZE; m++) {
+					if (outputs[i].file[m] != nullptr) {
+						if (!write_snapshot(registry, outputs[i], i, m, frame_at(first + count - 1), percentiles, workspaces)) {
+							exit(EXIT_FAILURE);
+						}
+					}
+				}
+			}
 		}
+	}
 
-		std::cout << std::format("PSNR: {:.3}, WSPSNR: {:.3}\n", results[METRIC_PSNR][frame], results[METRIC_WSPSNR][frame]);
+	if (nbmeasured == 0) {
+		fprintf(stderr, "No frame to measure.\n");
+		return EXIT_FAILURE;
+	}
 
-		// Print quality index to file
-		std::cout << ". result: ";
+	// Print statistics to file
+	for (size_t i = 0; i < nbprocessed; i++) {
+		FILE* const *result_file = outputs[i].file;
+		float* const *results = outputs[i].results;
 		for (int m=0; m<METRIC_SIZE; m++) {
 			if (result_file[m] != nullptr) {
-				fprintf(result_file[m], "%d,%.6f\n", frame, static_cast<double>(results[m][frame]));
-				std::cout << results[m][frame] << "  ";
+				print_statistics(result_file[m], outputs[i], m, percentiles);
+				registry.summary(m, i, workspaces, result_file[m]);
+				fprintf(result_file[m], "measured frames,%d\n", nbmeasured);
+				if (sample > 0) {
+					fprintf(result_file[m], "frame selection,random %d of %d from %d by %d (seed %d)\n", nbmeasured, nbframes, start, stride, seed);
+				}
+				else {
+					fprintf(result_file[m], "frame selection,%d from %d by %d\n", nbmeasured, start, stride);
+				}
+
+				fclose(result_file[m]);
+				free(static_cast<void*>(results[m]));
 			}
 		}
-		std::cout << std::endl;
 	}
 
-	// Calcuate and print statistics to file
-	for (int m=0; m<METRIC_SIZE; m++) {
-		if (result_file[m] != nullptr) {
-			float avg = 0;
-			float stddev = 0;
+	delete original;
+	for (size_t i = 0; i < nbprocessed; i++) {
+		delete processed[i];
+	}
 
-			for (int frame=0; frame<nbframes; frame++)
-				avg += results[m][frame];
-			avg /= static_cast<float>(nbframes);
+	duration = static_cast<double>(cv::getTickCount())-duration;
+	duration /= cv::getTickFrequency();
+	//printf("Time: %0.3fs\n", duration);
 
-			for (int frame=0; frame<nbframes; frame++) {
-				float diff = results[m][frame] - avg;
-				stddev += diff * diff;
-			}
-			stddev = sqrtf(stddev / static_cast<float>(nbframes - 1));
+	return EXIT_SUCCESS;
+}
 
-			qsort(results[m], static_cast<size_t>(nbframes), sizeof(float), float_compare);
-			float p50 = calculate_percentile(results[m], nbframes, 0.50f);
-			float p90 = calculate_percentile(results[m], nbframes, 0.90f);
-			float p95 = calculate_percentile(results[m], nbframes, 0.95f);
-			float p99 = calculate_percentile(results[m], nbframes, 0.99f);
+// Compute the requested metrics of one frame for each processed video and
+// store them in the index-th slot of the results of outputs[i]
+// The terms which only depend on the original frame are computed once.
+// Each thread calls it with its own workspace.
+static void compute_metrics (const MetricRegistry& registry, int index, int frame, const FrameSet& set, std::vector<Output>& outputs, Workspace& ws)
+{
+	size_t nbprocessed = outputs.size();
 
+	for (size_t p = 0; p < registry.size(); p++) {
+		const MetricRegistry::Declaration& decl = registry.declaration(p);
+		const size_t nbmetrics = static_cast<size_t>(decl.nbmetrics);
 
-			fprintf(result_file[m], "average,%.6f\n", static_cast<double>(avg));
-			fprintf(result_file[m], "standard deviation,%.6f\n", static_cast<double>(stddev));
-			fprintf(result_file[m], "50th percentile,%.6f\n", static_cast<double>(p50));
-			fprintf(result_file[m], "90th percentile,%.6f\n", static_cast<double>(p90));
-			fprintf(result_file[m], "95th percentile,%.6f\n", static_cast<double>(p95));
-			fprintf(result_file[m], "99th percentile,%.6f\n", static_cast<double>(p99));
+		float *values = ws.getArena().allocate<float>(nbprocessed * nbmetrics * MetricRegistry::MAX_COLUMNS);
+		registry.provider(p).compute(set, frame, ws, values);
 
-			free(static_cast<void*>(results[m]));
-			fclose(result_file[m]);
+		for (int k = 0; k < decl.nbmetrics; k++) {
+			int m = decl.metrics[k];
+			if (registry.source(m) != static_cast<int>(p)) {
+				continue;
+			}
+			for (size_t i = 0; i < nbprocessed; i++) {
+				const float *columns = &values[(i * nbmetrics + static_cast<size_t>(k)) * MetricRegistry::MAX_COLUMNS];
+				for (int c = 0; c < MetricRegistry::columns(m); c++) {
+					outputs[i].results[m][c * outputs[i].nbslots + index] = columns[c];
+				}
+			}
 		}
 	}
+}
 
-	delete psnr;
-	delete ssim;
-	delete msssim;
-	delete vifp;
-	delete phvs;
-	delete wspsnr;
+// Result of a metric for the frame of the index-th slot, 0 if not requested
+static float result (const Output& output, int metric, int index)
+{
+	return output.results[metric] != nullptr ? output.results[metric][index] : 0;
+}
 
-	delete original;
-	delete processed;
+// Get the Y, U and V planes of the current frame of the video, as headers
+// on its frame data or as copies of it, which stay valid after the next
+// frame is read
+static void get_planes (const VideoYUV& video, cv::Mat *planes, bool copy)
+{
+	for (int c = 0; c < 3; c++) {
+		if (copy) {
+			video.getPlane(c).copyTo(planes[c]);
+		}
+		else {
+			planes[c] = video.getPlane(c);
+		}
+	}
+}
 
-	duration = static_cast<double>(cv::getTickCount())-duration;
-	duration /= cv::getTickFrequency();
-	//printf("Time: %0.3fs\n", duration);
+static bool parse_int (const char *str, int& value)
+{
+	char *endptr = nullptr;
+	value = static_cast<int>(strtol(str, &endptr, 10));
+	return *str && !*endptr;
+}
 
-	return EXIT_SUCCESS;
+// Parse the weights of the Y, U and V planes, given as WY:WU:WV
+static bool parse_weights (const char *str, double *weights)
+{
+	char *endptr = nullptr;
+	for (int c = 0; c < 3; c++) {
+		weights[c] = strtod(str, &endptr);
+		if (endptr == str || weights[c] < 0 || *endptr != (c < 2 ? ':' : '\0')) {
+			return false;
+		}
+		str = endptr + 1;
+	}
+	return weights[0] + weights[1] + weights[2] > 0;
 }
 
-static int float_compare (const void * a, const void * b)
+// Parse the percentiles of the summary, given as P1:P2:... from 0 to 100
+static bool parse_percentiles (const char *str, std::vector<double>& percentiles)
 {
-	float diff = *(static_cast<const float*>(a)) - *(static_cast<const float*>(b));
-	if (diff < 0)
-		return -1;
-	if (diff > 0)
-		return 1;
-	return 0;
+	percentiles.clear();
+	char *endptr = nullptr;
+	for (;;) {
+		double p = strtod(str, &endptr);
+		if (endptr == str || p < 0 || p > 100 || (*endptr != ':' && *endptr != '\0')) {
+			return false;
+		}
+		percentiles.push_back(p);
+		if (*endptr == '\0') {
+			return true;
+		}
+		str = endptr + 1;
+	}
 }
 
-static float calculate_percentile (const float* results, int nbframes, float p)
+static void select_frames (int start, int stride, int count, int sample, int seed, std::vector<int>& frames)
 {
-	float index = static_cast<float>(nbframes) * p;
-	float roundindex = roundf(index);
-	if (fabsf(index - roundindex) < FLT_EPSILON)
-		return (results[static_cast<int>(roundindex)] + results[static_cast<int>(roundindex + 1)]) / 2;
-	return results[static_cast<int>(roundindex)];
+	if (sample == 0 || sample >= count) {
+		for (int i = 0; i < count; i++) {
+			frames.push_back(start + i * stride);
+		}
+		return;
+	}
+
+	// Selection sampling: each candidate is kept with probability
+	// (frames still needed)/(candidates left), which keeps the order
+	std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+	int needed = sample;
+	for (int i = 0; i < count && needed > 0; i++) {
+		std::uniform_int_distribution<int> dist(0, count - i - 1);
+		if (dist(rng) < needed) {
+			frames.push_back(start + i * stride);
+			needed--;
+		}
+	}
+}
+
+// Print the average, the standard deviation and the percentiles of each
+// column of a metric
+static void print_statistics (FILE *file, const Output& output, int metric, const std::vector<double>& percentiles)
+{
+	const Statistics *stats = output.stats[metric];
+	const int columns = MetricRegistry::columns(metric);
+
+	fprintf(file, "average");
+	for (int c = 0; c < columns; c++) {
+		fprintf(file, ",%.6f", stats[c].mean());
+	}
+	fprintf(file, "\nstandard deviation");
+	for (int c = 0; c < columns; c++) {
+		fprintf(file, ",%.6f", stats[c].stddev());
+	}
+	fprintf(file, "\n");
+
+	for (size_t p = 0; p < percentiles.size(); p++) {
+		// 1st, 2nd, 3rd, 11th, 50th, 99.9th, ...
+		double rank = percentiles[p];
+		int integer = static_cast<int>(rank);
+		const char *ordinal = "th";
+		if (static_cast<double>(integer) >= rank && (integer % 100 < 11 || integer % 100 > 13)) {
+			ordinal = integer % 10 == 1 ? "st" : (integer % 10 == 2 ? "nd" : (integer % 10 == 3 ? "rd" : "th"));
+		}
+		fprintf(file, "%g%s percentile", rank, ordinal);
+		for (int c = 0; c < columns; c++) {
+			fprintf(file, ",%.6f", stats[c].quantile(rank / 100));
+		}
+		fprintf(file, "\n");
+	}
+}
+
+// Write the summary of the frames of a metric measured so far, up to the
+// given frame, to its snapshot file
+// The file is written under a temporary name, then renamed, so that its
+// readers always see a complete summary.
+static bool write_snapshot (const MetricRegistry& registry, const Output& output, size_t index, int metric, int frame,
+	const std::vector<double>& percentiles, const std::vector<Workspace>& workspaces)
+{
+	std::string name = output.summary[metric] + ".tmp";
+	FILE *file = fopen(name.c_str(), "w");
+	if (file == nullptr) {
+		fprintf(stderr, "Cannot open output file: %s\n", name.c_str());
+		return false;
+	}
+	fprintf(file, "statistic,%s\n", MetricRegistry::header(metric));
+	print_statistics(file, output, metric, percentiles);
+	registry.summary(metric, index, workspaces, file);
+	fprintf(file, "measured frames,%zu\n", output.stats[metric][0].count());
+	fprintf(file, "last frame,%d\n", frame);
+	if (fclose(file) != 0 || rename(name.c_str(), output.summary[metric].c_str()) != 0) {
+		fprintf(stderr, "Cannot write output file: %s\n", output.summary[metric].c_str());
+		return false;
+	}
+	return true;
 }
@@ -0,0 +1,242 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+
+/**************************************************************************
+
+ Check that the metrics do not allocate memory in steady state: once a
+ first frame has been computed, the arena of the workspace does not grow
+ anymore, and neither cv::Mat data nor operator new are allocated.
+ Every metric is computed as vqmt does, through the registry with a
+ feature cache and a thread pool attached to the workspace, except
+ EWPSNR which is given generated eye-tracking data.
+
+**************************************************************************/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <opencv2/core/core.hpp>
+#include "EWPSNR.hpp"
+#include "FeatureCache.hpp"
+#include "FrameSet.hpp"
+#include "MetricRegistry.hpp"
+#include "ThreadPool.hpp"
+#include "Workspace.hpp"
+
+namespace {
+	const int HEIGHT = 144;
+	const int WIDTH = 176;
+	const size_t NB_PROCESSED = 2;
+	const int NB_FRAMES = 5;
+	const int NB_THREADS = 3;
+	const char *const GAZES_FILE = "arena_test_gazes.csv";
+
+	std::atomic<size_t> nbnew(0);
+	std::atomic<size_t> nbmats(0);
+
+#if CV_VERSION_MAJOR >= 4
+	typedef cv::AccessFlag AccessFlags;
+#else
+	typedef int AccessFlags;
+#endif
+
+	// Allocator of the cv::Mat data counting the allocations, which go
+	// through cv::fastMalloc() and not operator new
+	class CountingAllocator : public cv::MatAllocator {
+	public:
+		CountingAllocator() : wrapped(cv::Mat::getStdAllocator()) {}
+		cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlags flags,
+			cv::UMatUsageFlags usageFlags) const
+		{
+			cv::UMatData *u = wrapped->allocate(dims, sizes, type, data, step, flags, usageFlags);
+			if (u != nullptr && data == nullptr) {
+				nbmats++;
+				u->currAllocator = this;
+			}
+			return u;
+		}
+		bool allocate(cv::UMatData *data, AccessFlags accessflags, cv::UMatUsageFlags usageFlags) const
+		{
+			return wrapped->allocate(data, accessflags, usageFlags);
+		}
+		void deallocate(cv::UMatData *data) const
+		{
+			wrapped->deallocate(data);
+		}
+	private:
+		cv::MatAllocator *wrapped;
+	};
+
+	// Fill the plane and its CV_32F conversion with pseudo-random samples
+	void fill(cv::Mat& plane, cv::Mat& img, unsigned int& seed)
+	{
+		for (int y = 0; y < img.rows; y++) {
+			unsigned char *samples = plane.ptr<unsigned char>(y);
+			float *row = img.ptr<float>(y);
+			for (int x = 0; x < img.cols; x++) {
+				seed = seed * 1103515245u + 12345u;
+				samples[x] = static_cast<unsigned char>((seed >> 16) & 0xff);
+				row[x] = samples[x];
+			}
+		}
+	}
+
+	// Write an eye-tracking file of the SFU database with 15 gazes per
+	// frame around the center of the image
+	bool write_gazes(const char *path)
+	{
+		FILE *file = fopen(path, "w");
+		if (file == nullptr) {
+			fprintf(stderr, "Error: cannot create %s\n", path);
+			return false;
+		}
+		fprintf(file, "Gazes\nx,y,x,y\n");
+		for (int f = 0; f < NB_FRAMES; f++) {
+			for (int g = 0; g < 15; g++) {
+				int x = WIDTH / 2 + 3 * (g - 7) + f;
+				int y = HEIGHT / 2 + 2 * (g - 7) - f;
+				fprintf(file, "%d,%d,%d,%d,", x, y, x, y);
+			}
+			fprintf(file, "\n");
+		}
+		fclose(file);
+		return true;
+	}
+}
+
+void *operator new(size_t size)
+{
+	nbnew++;
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *p, size_t /* size */) noexcept
+{
+	free(p);
+}
+#endif
+
+int main()
+{
+	CountingAllocator allocator;
+	cv::MatAllocator *previous = cv::Mat::getDefaultAllocator();
+	cv::Mat::setDefaultAllocator(&allocator);
+
+	bool requested[METRIC_SIZE];
+	for (int m = 0; m < METRIC_SIZE; m++) {
+		requested[m] = m != METRIC_EWPSNR;
+	}
+	MetricRegistry registry(requested);
+	MetricRegistry::Parameters params = {HEIGHT, WIDTH, HEIGHT / 2, 8, "arena_test", {1.0, 1.0, 1.0}};
+	if (!registry.checkSize(HEIGHT, WIDTH)) {
+		return EXIT_FAILURE;
+	}
+	registry.create(params);
+
+	EWPSNR ewpsnr(HEIGHT, WIDTH);
+	bool loaded = write_gazes(GAZES_FILE) && ewpsnr.load_eye_track_data(GAZES_FILE);
+	remove(GAZES_FILE);
+	if (!loaded) {
+		return EXIT_FAILURE;
+	}
+
+	FrameSet set;
+	set.allocate(HEIGHT, WIDTH, HEIGHT / 2, WIDTH / 2, true, true, NB_PROCESSED);
+	for (size_t c = 0; c < 3; c++) {
+		int rows = c == 0 ? HEIGHT : HEIGHT / 2;
+		int cols = c == 0 ? WIDTH : WIDTH / 2;
+		set.original_planes[c].create(rows, cols, CV_8UC1);
+		for (size_t i = 0; i < NB_PROCESSED; i++) {
+			set.processed_planes[3 * i + c].create(rows, cols, CV_8UC1);
+		}
+	}
+	std::vector<float> values(NB_PROCESSED * MetricRegistry::MAX_METRICS * MetricRegistry::MAX_COLUMNS);
+
+	ThreadPool pool(NB_THREADS);
+	FeatureCache cache;
+	Workspace ws;
+	ws.setCache(&cache);
+	ws.setThreadPool(&pool);
+	unsigned int seed = 1;
+
+	size_t blocks = 0;
+	size_t mats = 0;
+	size_t news = 0;
+	for (int f = 0; f < NB_FRAMES; f++) {
+		fill(set.original_planes[0], set.original, seed);
+		for (size_t c = 0; c < 2; c++) {
+			fill(set.original_planes[c + 1], set.original_chroma[c], seed);
+		}
+		for (size_t i = 0; i < NB_PROCESSED; i++) {
+			fill(set.processed_planes[3 * i], set.processed[i], seed);
+			for (size_t c = 0; c < 2; c++) {
+				fill(set.processed_planes[3 * i + c + 1], set.processed_chroma[2 * i + c], seed);
+			}
+		}
+		cache.clear();
+		ws.clear();
+		// The first frame sizes the arena and creates the states, which
+		// are kept from then on
+		if (f == 1) {
+			blocks = ws.getArena().blockCount();
+			mats = nbmats;
+			news = nbnew;
+		}
+
+		for (size_t p = 0; p < registry.size(); p++) {
+			registry.provider(p).compute(set, f, ws, values.data());
+		}
+		ewpsnr.set_frame_no(ws, static_cast<unsigned int>(f));
+		for (size_t i = 0; i < NB_PROCESSED; i++) {
+			ewpsnr.compute(set.original, set.processed[i], ws);
+		}
+	}
+
+	cv::Mat::setDefaultAllocator(previous);
+	if (ws.getArena().blockCount() != blocks) {
+		fprintf(stderr, "Error: the arena allocated %zu blocks after the first frame\n", ws.getArena().blockCount() - blocks);
+		return EXIT_FAILURE;
+	}
+	if (nbmats != mats) {
+		fprintf(stderr, "Error: %zu cv::Mat were allocated after the first frame\n", nbmats - mats);
+		return EXIT_FAILURE;
+	}
+	if (nbnew != news) {
+		fprintf(stderr, "Error: operator new was called %zu times after the first frame\n", nbnew - news);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
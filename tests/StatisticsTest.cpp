@@ -0,0 +1,170 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+
+/**************************************************************************
+
+ Check the statistics against the ones of the sorted values: the mean and
+ standard deviation, the quantiles, exact up to COMPRESSION values and
+ within a small error in rank above, and the merge of the statistics of
+ disjoint sets of values.
+
+**************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "Statistics.hpp"
+
+namespace {
+	const double QUANTILES[] = {0.0, 0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 1.0};
+	const size_t NB_QUANTILES = sizeof(QUANTILES) / sizeof(QUANTILES[0]);
+	// Largest difference between q and the rank of an approximate quantile
+	// q, as a fraction of the number of values
+	const double RANK_TOLERANCE = 0.005;
+
+	// Pseudo-random values with a skewed distribution, like the ones of a
+	// metric over the frames of a video
+	std::vector<double> values(size_t n, unsigned int seed)
+	{
+		std::vector<double> v(n);
+		for (size_t i = 0; i < n; i++) {
+			seed = seed * 1103515245u + 12345u;
+			double u = static_cast<double>((seed >> 8) & 0xffffff) / 16777216.0;
+			v[i] = 40.0 - 10.0 * u * u;
+		}
+		return v;
+	}
+
+	// Quantile q of the sorted values, interpolated linearly between them
+	double quantile(const std::vector<double>& sorted, double q)
+	{
+		double rank = q * static_cast<double>(sorted.size() - 1);
+		size_t i = static_cast<size_t>(rank);
+		if (i + 1 >= sorted.size()) {
+			return sorted.back();
+		}
+		return sorted[i] + (sorted[i + 1] - sorted[i]) * (rank - static_cast<double>(i));
+	}
+
+	// Fraction of the sorted values below value
+	double rankOf(const std::vector<double>& sorted, double value)
+	{
+		size_t below = static_cast<size_t>(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin());
+		return static_cast<double>(below) / static_cast<double>(sorted.size() - 1);
+	}
+
+	bool close(double a, double b, double tolerance)
+	{
+		return std::fabs(a - b) <= tolerance * std::max(1.0, std::fabs(b));
+	}
+
+	// Compare the statistics of the values with the reference ones
+	bool check(const char *name, const Statistics& stats, const std::vector<double>& v)
+	{
+		std::vector<double> sorted(v);
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0;
+		for (size_t i = 0; i < v.size(); i++) {
+			sum += v[i];
+		}
+		const double mean = sum / static_cast<double>(v.size());
+		double sq = 0;
+		for (size_t i = 0; i < v.size(); i++) {
+			sq += (v[i] - mean) * (v[i] - mean);
+		}
+		const double stddev = std::sqrt(sq / static_cast<double>(v.size() - 1));
+
+		bool ok = true;
+		if (stats.count() != v.size()) {
+			fprintf(stderr, "%s: count %zu instead of %zu\n", name, stats.count(), v.size());
+			ok = false;
+		}
+		if (!close(stats.mean(), mean, 1e-12)) {
+			fprintf(stderr, "%s: mean %.15g instead of %.15g\n", name, stats.mean(), mean);
+			ok = false;
+		}
+		if (!close(stats.stddev(), stddev, 1e-9)) {
+			fprintf(stderr, "%s: standard deviation %.15g instead of %.15g\n", name, stats.stddev(), stddev);
+			ok = false;
+		}
+		// The minimum and the maximum are always exact
+		for (size_t k = 0; k < NB_QUANTILES; k++) {
+			const double q = QUANTILES[k];
+			const double value = stats.quantile(q);
+			if (v.size() <= static_cast<size_t>(Statistics::COMPRESSION) || k == 0 || k == NB_QUANTILES - 1) {
+				if (!close(value, quantile(sorted, q), 1e-12)) {
+					fprintf(stderr, "%s: quantile %g is %.15g instead of %.15g\n", name, q, value, quantile(sorted, q));
+					ok = false;
+				}
+			}
+			else if (std::fabs(rankOf(sorted, value) - q) > RANK_TOLERANCE) {
+				fprintf(stderr, "%s: quantile %g is %.15g, at rank %g\n", name, q, value, rankOf(sorted, value));
+				ok = false;
+			}
+		}
+		return ok;
+	}
+
+	// Statistics of the values, added one by one
+	Statistics add(const std::vector<double>& v, size_t first, size_t last)
+	{
+		Statistics stats;
+		for (size_t i = first; i < last; i++) {
+			stats.add(v[i]);
+		}
+		return stats;
+	}
+
+	// Statistics of the values, merged from the ones of nbparts slices
+	Statistics merge(const std::vector<double>& v, size_t nbparts)
+	{
+		Statistics stats;
+		for (size_t p = 0; p < nbparts; p++) {
+			stats.merge(add(v, v.size() * p / nbparts, v.size() * (p + 1) / nbparts));
+		}
+		return stats;
+	}
+}
+
+int main()
+{
+	const size_t SIZES[] = {2, 7, 150, 200, 201, 1000, 100000};
+	bool ok = true;
+	for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+		const std::vector<double> v = values(SIZES[s], static_cast<unsigned int>(s + 1));
+		char name[64];
+		snprintf(name, sizeof(name), "%zu values", v.size());
+		ok &= check(name, add(v, 0, v.size()), v);
+		if (v.size() >= 4) {
+			snprintf(name, sizeof(name), "%zu values in 2 parts", v.size());
+			ok &= check(name, merge(v, 2), v);
+			snprintf(name, sizeof(name), "%zu values in 4 parts", v.size());
+			ok &= check(name, merge(v, 4), v);
+		}
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}